@@ -0,0 +1,112 @@
+/*
+  DSOaverage.c: linear and exponential averaging of triggered acquisitions.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Traces arrive as float codes (fractional once filtered or in Hi-Res mode)
+  and are held as fixed point with 7 fractional bits.  A filter overshoots
+  a clipped edge, so codes are first clamped to -256 to 511 and offset by
+  256: held values are never negative and the largest sum fits an int32.
+  The linear average keeps the last N traces in a ring so each update is
+  one subtract and one add per point whatever N is.  The exponential
+  average carries a further 8 bits so that shifting by up to log2(256)
+  loses nothing visible.  All the per point loops are straight int32
+  arithmetic and vectorise.
+*/
+
+
+#include <string.h>
+#include "DSOaverage.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define FIX 128.0f                                 // 7 bit fractional codes
+#define BIAS 256.0f               // added to codes, kept from -BIAS to 2 * BIAS
+
+
+DSO_AVERAGE Average1 = {.Type = AVERAGE_OFF, .Shots = 16};
+DSO_AVERAGE Average2 = {.Type = AVERAGE_OFF, .Shots = 16};
+
+
+void average_reset(DSO_AVERAGE* Average)        // settings changed: start again
+{
+  Average->Count = 0;
+}
+
+
+static inline int32_t fix(float code)                     // 0 to 3 * BIAS * FIX
+{
+  code = code >= -BIAS ? code : -BIAS;                            // NaN as well
+  code = code <= 2 * BIAS - 1 ? code : 2 * BIAS - 1;
+  return (int32_t)((code + BIAS) * FIX);
+}
+
+
+float* average_update                  // add a trace and return the average
+(
+  DSO_AVERAGE* Average,
+  float* CH,                                      // latest trace, as codes
+  unsigned int Frame,                         // acquisition sequence number
+  int n                                               // display buffer size
+)
+{
+  int32_t* acc = Average->Acc;
+  int32_t* r;
+  float* out = Average->Out;
+  float scale;
+  int shift;
+  int i;
+
+  if(Average->Count && Frame == Average->Frame) return out; // redisplay only
+  Average->Frame = Frame;
+
+  for(shift = 0; (2 << shift) <= Average->Shots; shift++);  // log2(Shots)
+
+  if(Average->Type == AVERAGE_EXP)
+  {
+    if(Average->Count == 0)
+      for(i = 0; i < n; i++) acc[i] = fix(CH[i]) * 256;
+    else                                            // both shifted are positive
+      for(i = 0; i < n; i++)
+        acc[i] += ((fix(CH[i]) * 256) >> shift) - (acc[i] >> shift);
+    if(Average->Count < Average->Shots) Average->Count++;
+
+    scale = 1.0f / (FIX * 256);
+    for(i = 0; i < n; i++) out[i] = acc[i] * scale - BIAS;
+    return out;
+  }
+
+  r = Average->Ring[Average->Count % Average->Shots];   // oldest trace slot
+  if(Average->Count == 0) memset(acc, 0, sizeof(Average->Acc));
+  if(Average->Count >= Average->Shots)
+    for(i = 0; i < n; i++) acc[i] -= r[i];
+  for(i = 0; i < n; i++) r[i] = fix(CH[i]), acc[i] += r[i];
+
+  if(++Average->Count == 2 * Average->Shots) Average->Count = Average->Shots;
+
+  i = Average->Count < Average->Shots ? Average->Count : Average->Shots;
+  scale = 1.0f / (FIX * i);
+  for(i = 0; i < n; i++) out[i] = acc[i] * scale - BIAS;
+  return out;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,68 @@
+/*
+  DSOaverage.h: triggered waveform averaging for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOAVERAGE_H
+#define DSOAVERAGE_H
+
+#include <stdint.h>
+#include "HT6022.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define AVERAGE_MAX 256                     // most acquisitions in an average
+
+
+typedef enum
+{
+  AVERAGE_OFF,
+  AVERAGE_LINEAR,                          // mean of the last Shots triggers
+  AVERAGE_EXP                       // exponential, time constant Shots triggers
+} AVERAGE_TYPE_TypeDef;
+
+typedef struct DSO_AVERAGE
+{
+  AVERAGE_TYPE_TypeDef Type;
+  int Shots;                                // N: a power of two, 2 to 256
+  int Count;                        // acquisitions accumulated since reset
+  unsigned int Frame;                   // last acquisition added, see worker
+  int32_t Acc[HT6022_1KB];                       // running sum, fixed point
+  int32_t Ring[AVERAGE_MAX][HT6022_1KB];  // linear: codes of last N traces
+  float Out[HT6022_1KB];                               // averaged trace codes
+} DSO_AVERAGE;
+
+
+extern DSO_AVERAGE Average1, Average2;
+
+extern void average_reset(DSO_AVERAGE* Average);
+extern float* average_update
+(
+  DSO_AVERAGE* Average,
+  float* CH,                                      // latest trace, as codes
+  unsigned int Frame,                         // acquisition sequence number
+  int n                                               // display buffer size
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOAVERAGE_H
@@ -0,0 +1,456 @@
+/*
+  DSOcal.c: offset and gain of each input range measured against ground
+  or the calibrator, kept in a file and in the 'scope's own EEPROM.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  The 6022 has four input ranges, each with its own amplifier offset and
+  gain error; the six volts per division settings share them.  A run
+  takes each range in turn, discards the first CAL_SETTLE acquisitions
+  after switching, then adds the codes of the next CAL_SHOTS, every
+  sample of each, to a histogram per channel.  With the probes grounded
+  the offset is the mean code.  On the calibrator, a square wave from 0V
+  to Volts, the histogram is split into its low and high levels, and
+  each is averaged within a quarter step of itself so edges and overshoot
+  count for nothing: the low level gives the offset, the step the gain.
+  A range whose high level clips, as 2V does on the 2V and 1V ranges,
+  gets its offset but keeps its gain; one where no step is seen, or the
+  gain is beyond CAL_GAIN_LIMIT, keeps both.
+
+  Corrections apply as the VScale and Zero of a channel, from which its
+  table of volts and screen position per code is made: see DSOscale.c.
+
+  The file, ~/.scope_cal, is text with a version on its first line and
+  one line per range, written to path.tmp and renamed as the session is.
+  The EEPROM block is CAL_EEPROM bytes, replacing Hantek's own offsets
+  there: "DC", version, a byte making the sum of all zero, offsets in
+  quarter codes then gains less one in 1/65536, each per channel and
+  range.  The file keeps full precision; the block goes with the 'scope.
+  Other software relies on what Hantek left there, so before it is first
+  replaced the block as found is added to ~/.scope_cal.orig, one line of
+  hex for each 'scope, and a block that cannot be kept is not replaced.
+
+  Reading the EEPROM is known to return variable data, see HT6022.c, so
+  it is read only when the user asks, and cal_fetch() reads it twice and
+  trusts it only if both reads agree.  Even then a block is replaced only
+  if it is ours or looks like Hantek's, cal_hantek(): every byte an
+  offset within CAL_HANTEK_SPAN of mid-scale, or erased.  A wrong copy in
+  ~/.scope_cal.orig would otherwise cost the real one.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "DSOcal.h"
+#include "DSOutils.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static const HT6022_IRTypeDef Range[CAL_RANGES] =
+  {HT6022_10V, HT6022_5V, HT6022_2V, HT6022_1V};
+static const char* Name[CAL_RANGES] = {"10V", "5V", "2V", "1V"};
+static const double Span[CAL_RANGES] = {10.0, 5.0, 2.0, 1.0}; // volts, full
+
+static const double Offset1[CAL_RANGES] = {-1, 0, 1, 2}; // before any is run
+static const double Offset2[CAL_RANGES] = {9, 10, 11, 12};
+
+
+int cal_range(HT6022_IRTypeDef IR)                        // 0 to CAL_RANGES - 1
+{
+  int r;
+
+  for(r = 0; r < CAL_RANGES - 1 && Range[r] != IR; r++);
+  return r;
+}
+
+
+HT6022_IRTypeDef cal_ir(int range)
+{
+  return Range[range < CAL_RANGES ? range : CAL_RANGES - 1];
+}
+
+
+double cal_nominal(int range)                     // volts per code, uncorrected
+{
+  return Span[range] / 256;
+}
+
+
+void cal_default(DSO_CAL* Cal)
+{
+  int r;
+
+  for(r = 0; r < CAL_RANGES; r++)
+  {
+    Cal->Offset[0][r] = Offset1[r];
+    Cal->Offset[1][r] = Offset2[r];
+    Cal->Gain[0][r] = Cal->Gain[1][r] = 1;
+  }
+}
+
+
+void cal_channel                                // VScale and Zero for its range
+(
+  DSO_CHANNEL* Channel,
+  int channel,                                                         // 0 or 1
+  const DSO_CAL* Cal
+)
+{
+  int r = cal_range(Channel->VRange);
+
+  Channel->VScale = cal_nominal(r) * 128 / Cal->Gain[channel][r];
+  Channel->Zero = Cal->Offset[channel][r];
+}
+
+
+int cal_path(char* path, int n)                                  // ~/.scope_cal
+{
+  return get_home_path(path, CAL_FILE, n);
+}
+
+
+bool cal_write(const char* path, const DSO_CAL* Cal)      // replaces, or leaves
+{
+  char tmp[160];
+  FILE* f;
+  bool ok;
+  int r;
+
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return false;
+  if((f = fopen(tmp, "wt")) == NULL) return false;
+  ok = fprintf(f, "DSOCAL %d\n", CAL_VERSION) > 0;
+  for(r = 0; r < CAL_RANGES && ok; r++)
+    ok = fprintf
+    (
+      f, "%s, %.4f, %.6f, %.4f, %.6f\n", Name[r],
+      Cal->Offset[0][r], Cal->Gain[0][r], Cal->Offset[1][r], Cal->Gain[1][r]
+    ) > 0;
+  ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if(fclose(f) != 0) ok = false;
+  if(ok && rename(tmp, path) == 0) return true;
+  unlink(tmp);
+  return false;
+}
+
+
+bool cal_read(const char* path, DSO_CAL* Cal)       // Cal unchanged unless read
+{
+  DSO_CAL c;
+  char line[128];
+  FILE* f;
+  int version = 0;
+  int r;
+
+  if((f = fopen(path, "rt")) == NULL) return false;
+  if(fgets(line, sizeof(line), f) == NULL ||
+    sscanf(line, "DSOCAL %d", &version) != 1 || version != CAL_VERSION)
+  {
+    fclose(f);
+    return false;
+  }
+  for(r = 0; r < CAL_RANGES; r++)
+    if
+    (
+      fgets(line, sizeof(line), f) == NULL ||
+      sscanf
+      (
+        line, "%*[^,], %lf, %lf, %lf, %lf",
+        &c.Offset[0][r], &c.Gain[0][r], &c.Offset[1][r], &c.Gain[1][r]
+      ) != 4 ||
+      fabs(c.Gain[0][r] - 1) > CAL_GAIN_LIMIT ||
+      fabs(c.Gain[1][r] - 1) > CAL_GAIN_LIMIT
+    ) break;
+  fclose(f);
+  if(r < CAL_RANGES) return false;
+  memcpy(Cal->Offset, c.Offset, sizeof(c.Offset));
+  memcpy(Cal->Gain, c.Gain, sizeof(c.Gain));
+  return true;
+}
+
+
+bool cal_read_legacy(const char* path, DSO_CAL* Cal)            // from ~/.scope
+{
+  double zero[2][6];                            // by volts per division setting
+  double factor;                                   // on VScale, for every range
+  FILE* f;
+  bool ok = true;
+  int i;
+  int r;
+
+  if((f = fopen(path, "rt")) == NULL) return false;
+  for(i = 0; i < 6 && ok; i++)
+    ok = fscanf(f, "%lf, %lf, ", &zero[0][i], &zero[1][i]) == 2;
+  ok = ok && fscanf(f, "%lf", &factor) == 1 && factor > 0;
+  fclose(f);
+  if(!ok) return false;
+
+  for(r = 0; r < CAL_RANGES; r++)           // 1V/div is the first on each range
+  {
+    Cal->Offset[0][r] = zero[0][r + 1];
+    Cal->Offset[1][r] = zero[1][r + 1];
+    Cal->Gain[0][r] = Cal->Gain[1][r] = 1 / factor;
+  }
+  return true;
+}
+
+
+void cal_pack(const DSO_CAL* Cal, unsigned char* Block)      // CAL_EEPROM bytes
+{
+  unsigned char sum = 0;
+  double v;
+  int16_t g;
+  int c;
+  int r;
+  int i;
+
+  memset(Block, 0, CAL_EEPROM);
+  Block[0] = 'D';
+  Block[1] = 'C';
+  Block[2] = CAL_VERSION;
+  for(c = 0; c < 2; c++)
+    for(r = 0; r < CAL_RANGES; r++)
+    {
+      i = c * CAL_RANGES + r;
+      v = floor(Cal->Offset[c][r] * 4 + 0.5);
+      v = v < -128 ? -128 : v > 127 ? 127 : v;
+      Block[4 + i] = (unsigned char)(int8_t)v;
+      v = floor((Cal->Gain[c][r] - 1) * 65536 + 0.5);
+      g = (int16_t)(v < -32768 ? -32768 : v > 32767 ? 32767 : v);
+      Block[12 + 2 * i] = (uint16_t)g & 0xFF;
+      Block[13 + 2 * i] = (uint16_t)g >> 8;
+    }
+  for(i = 0; i < CAL_EEPROM; i++) sum += Block[i];
+  Block[3] = -sum;
+}
+
+
+bool cal_unpack(DSO_CAL* Cal, const unsigned char* Block) // unchanged if bad
+{
+  unsigned char sum = 0;
+  int16_t g;
+  int c;
+  int r;
+  int i;
+
+  for(i = 0; i < CAL_EEPROM; i++) sum += Block[i];
+  if(Block[0] != 'D' || Block[1] != 'C' || Block[2] != CAL_VERSION || sum)
+    return false;                              // Hantek's own, or never written
+  for(c = 0; c < 2; c++)
+    for(r = 0; r < CAL_RANGES; r++)
+    {
+      i = c * CAL_RANGES + r;
+      g = (int16_t)(Block[12 + 2 * i] | Block[13 + 2 * i] << 8);
+      Cal->Offset[c][r] = (int8_t)Block[4 + i] / 4.0;
+      Cal->Gain[c][r] = 1 + g / 65536.0;
+    }
+  return true;
+}
+
+
+bool cal_keep_original          // Block as read, unless ours: false if not kept
+(
+  const unsigned char* Block
+)
+{
+  DSO_CAL c;
+  char path[128];
+  char hex[2 * CAL_EEPROM + 1];
+  char line[2 * CAL_EEPROM + 8];
+  FILE* f;
+  bool ok;
+  int i;
+
+  if(cal_unpack(&c, Block)) return true;                // original kept already
+  if(!get_home_path(path, CAL_ORIGINAL, sizeof(path))) return false;
+  for(i = 0; i < CAL_EEPROM; i++) sprintf(hex + 2 * i, "%02X", Block[i]);
+  if((f = fopen(path, "a+t")) == NULL) return false;
+  rewind(f);
+  while(fgets(line, sizeof(line), f))                    // once for each 'scope
+    if(!strncmp(line, hex, 2 * CAL_EEPROM))
+    {
+      fclose(f);
+      return true;
+    }
+  fseek(f, 0, SEEK_END);
+  ok = fprintf(f, "%s\n", hex) > 0 && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if(fclose(f) != 0) ok = false;
+  return ok;
+}
+
+
+bool cal_hantek(const unsigned char* Block)      // as Hantek's software left it
+{
+  int i;
+
+  for(i = 0; i < CAL_EEPROM; i++)
+    if(Block[i] != 0xFF && abs(Block[i] - 128) > CAL_HANTEK_SPAN) return false;
+  return true;
+}
+
+
+bool cal_fetch               // EEPROM block, true only if two reads of it agree
+(
+  HT6022_DeviceTypeDef* Device,                     // held by the caller's lock
+  unsigned char* Block
+)
+{
+  unsigned char again[CAL_EEPROM];
+
+  return
+    HT6022_GetCalValues(Device, Block, CAL_EEPROM) == HT6022_SUCCESS &&
+    HT6022_GetCalValues(Device, again, CAL_EEPROM) == HT6022_SUCCESS &&
+    memcmp(Block, again, CAL_EEPROM) == 0;
+}
+
+
+void cal_start
+(
+  DSO_CAL_RUN* Run,
+  const DSO_CAL* From,                       // kept for what cannot be measured
+  bool Gain,                                                    // on calibrator
+  double Volts                                              // its step, if Gain
+)
+{
+  memset(Run, 0, sizeof(*Run));
+  Run->Gain = Gain;
+  Run->Volts = Volts;
+  Run->Shots = -CAL_SETTLE;
+  Run->Result = *From;
+}
+
+
+static double mean                          // of codes lo to hi - 1, -1 if none
+(
+  const uint32_t* h,
+  int lo,
+  int hi
+)
+{
+  double sum = 0;
+  double n = 0;
+  int i;
+
+  if(lo < 0) lo = 0;
+  if(hi > 256) hi = 256;
+  for(i = lo; i < hi; i++)
+  {
+    sum += (double)h[i] * i;
+    n += h[i];
+  }
+  return n > 0 ? sum / n : -1;
+}
+
+
+static void levels(const uint32_t* h, double* lo, double* hi)
+{
+  double t = mean(h, 0, 256);
+  double q;
+  int i;
+
+  for(i = 0; i < 8; i++)                     // threshold midway between the two
+  {
+    *lo = mean(h, 0, (int)ceil(t));
+    *hi = mean(h, (int)ceil(t), 256);
+    if(*lo < 0 || *hi < 0) break;
+    t = (*lo + *hi) / 2;
+  }
+  if(*lo < 0 || *hi < 0)
+  {
+    *lo = *hi = t;                                             // one level only
+    return;
+  }
+  q = (*hi - *lo) / 4;                                        // flat parts only
+  *lo = mean(h, (int)ceil(*lo - q), (int)floor(*lo + q) + 1);
+  *hi = mean(h, (int)ceil(*hi - q), (int)floor(*hi + q) + 1);
+}
+
+
+static void measure(DSO_CAL_RUN* Run, int c)         // this channel, this range
+{
+  const uint32_t* h = Run->Histogram[c];
+  const unsigned int bit = 1u << (c * CAL_RANGES + Run->Range);
+  const double step = Run->Volts / cal_nominal(Run->Range);         // at gain 1
+  double clip = 0;
+  double lo;
+  double hi;
+  double g;
+  int i;
+
+  for(i = 0; i < 256; i++) clip += h[i];
+  clip /= 100;                                  // more at either end is clipped
+  if(!Run->Gain)
+  {
+    if(h[0] > clip || h[255] > clip) return;                     // not grounded
+    Run->Result.Offset[c][Run->Range] = mean(h, 0, 256) - 128;
+    Run->Offsets |= bit;
+    return;
+  }
+
+  levels(h, &lo, &hi);
+  if(hi - lo < 8 || h[0] > clip) return;             // no step, or off the foot
+  Run->Result.Offset[c][Run->Range] = lo - 128;          // calibrator low is 0V
+  Run->Offsets |= bit;
+  if(h[255] > clip) return;                               // step is off the top
+  g = (hi - lo) / step;
+  if(fabs(g - 1) > CAL_GAIN_LIMIT) return;
+  Run->Result.Gain[c][Run->Range] = g;
+  Run->Gains |= bit;
+}
+
+
+bool cal_feed                         // true as each range is done, then switch
+(
+  DSO_CAL_RUN* Run,
+  const FRAME_CHANNEL* CH1,              // an acquisition on cal_ir(Run->Range)
+  const FRAME_CHANNEL* CH2
+)
+{
+  const FRAME_CHANNEL* Src[2] = {CH1, CH2};
+  const unsigned char* p;
+  uint32_t* h;
+  int c;
+  int i;
+
+  if(Run->Range >= CAL_RANGES) return false;
+  if(Run->Shots++ < 0) return false;                     // range still settling
+  for(c = 0; c < 2; c++)
+  {
+    p = Src[c]->Data;
+    h = Run->Histogram[c];
+    for(i = 0; i < Src[c]->Length; i++) h[p[i * Src[c]->Stride]]++;
+  }
+  if(Run->Shots < CAL_SHOTS) return false;
+
+  measure(Run, 0);
+  measure(Run, 1);
+  memset(Run->Histogram, 0, sizeof(Run->Histogram));
+  Run->Shots = -CAL_SETTLE;
+  Run->Range++;
+  return true;
+}
+
+#ifdef __cplusplus
+    }
+#endif
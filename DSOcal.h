@@ -0,0 +1,100 @@
+/*
+  DSOcal.h: offset and gain calibration of each input range of the 6022
+  'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOCAL_H
+#define DSOCAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dso.h"
+#include "DSOframe.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define CAL_VERSION 1
+#define CAL_FILE "/.scope_cal"                              // in home directory
+#define CAL_LEGACY "/.scope"                     // offsets and one scale factor
+#define CAL_ORIGINAL "/.scope_cal.orig"          // EEPROM blocks as first found
+#define CAL_RANGES 4                              // 10V, 5V, 2V and 1V, in turn
+#define CAL_SHOTS 16                      // acquisitions averaged on each range
+#define CAL_SETTLE 2                     // discarded after the range is changed
+#define CAL_GAIN_LIMIT 0.1                  // largest plausible error, fraction
+#define CAL_EEPROM HT6022_64B           // 32 bytes, whatever its name, 28 used:
+                                      // see HT6022_GetCalValues() and SetCal...
+#define CAL_HANTEK_SPAN 48            // Hantek's offsets lie within this of 128
+
+
+typedef struct DSO_CAL
+{
+  double Offset[2][CAL_RANGES];        // code at 0V less 128, channel and range
+  double Gain[2][CAL_RANGES];         // codes per volt over nominal, 1 if unset
+} DSO_CAL;
+
+typedef struct DSO_CAL_RUN                            // measurement in progress
+{
+  bool Gain;                          // on the calibrator, else probes grounded
+  double Volts;                                          // calibrator step, p-p
+  int Range;                             // being measured, CAL_RANGES when done
+  int Shots;                                    // taken on it, from -CAL_SETTLE
+  uint32_t Histogram[2][256];                     // codes of Shots, per channel
+  unsigned int Offsets;                       // bit per channel and range found
+  unsigned int Gains;
+  DSO_CAL Result;                                          // as measured so far
+} DSO_CAL_RUN;
+
+
+extern DSO_CAL Cal;                                // in use, see mainwindow.cpp
+
+extern int cal_range(HT6022_IRTypeDef IR);
+extern HT6022_IRTypeDef cal_ir(int range);
+extern double cal_nominal(int range);
+extern void cal_default(DSO_CAL* Cal);
+extern void cal_channel(DSO_CHANNEL* Channel, int channel, const DSO_CAL* Cal);
+extern int cal_path(char* path, int n);
+extern bool cal_write(const char* path, const DSO_CAL* Cal);
+extern bool cal_read(const char* path, DSO_CAL* Cal);
+extern bool cal_read_legacy(const char* path, DSO_CAL* Cal);
+extern void cal_pack(const DSO_CAL* Cal, unsigned char* Block);
+extern bool cal_unpack(DSO_CAL* Cal, const unsigned char* Block);
+extern bool cal_keep_original(const unsigned char* Block);
+extern bool cal_hantek(const unsigned char* Block);
+extern bool cal_fetch(HT6022_DeviceTypeDef* Device, unsigned char* Block);
+extern void cal_start
+(
+  DSO_CAL_RUN* Run,
+  const DSO_CAL* From,
+  bool Gain,
+  double Volts
+);
+extern bool cal_feed
+(
+  DSO_CAL_RUN* Run,
+  const FRAME_CHANNEL* CH1,
+  const FRAME_CHANNEL* CH2
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOCAL_H
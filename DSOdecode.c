@@ -0,0 +1,349 @@
+/*
+  DSOdecode.c: serial protocol decoding of captured channel data.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Both channels are first reduced to one bit per sample, 64 samples to a
+  word, so a whole 1MB capture becomes 256KB of bit streams.  The decoders
+  then jump from edge to edge by counting trailing zeros of the exclusive
+  or of each word with its idle level rather than looking at samples one by
+  one, so long idle periods between characters cost almost nothing.
+
+  All decoder state lives in DSO_DECODE, so decode_run() can be called with
+  a limited number of samples at a time and more data appended to the bit
+  streams in between; a frame that runs past the data so far is simply
+  retried on the next call.  In roll mode each transfer is appended as it
+  arrives, of any length, so the last word of one is topped up by the
+  next; the gap of a millisecond or so between transfers is not seen.
+*/
+
+
+#include <string.h>
+#include "DSOdecode.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+DSO_DECODE Decode =
+{
+  .Protocol = DECODE_OFF, .Baud = 9600, .DataBits = 8, .Gap = 10e-6,
+  .Threshold = {1.4, 1.4}
+};
+
+enum { IDLE, ADDRESS, DATA };                                  // I2C states
+
+
+static inline int bit(const uint64_t* b, int i)
+{
+  return (b[i >> 6] >> (i & 63)) & 1;
+}
+
+
+static int next_edge                // first sample after i at the other level
+(
+  const uint64_t* b,
+  int i,
+  int n                                             // returned if no edge
+)
+{
+  uint64_t v = bit(b, i) ? ~0ULL : 0;
+  uint64_t x;
+  int w = i >> 6;
+
+  x = (b[w] ^ v) & (~0ULL << (i & 63));
+  while(!x)
+  {
+    if(++w >= (n + 63) >> 6) return n;
+    x = b[w] ^ v;
+  }
+  i = (w << 6) + __builtin_ctzll(x);
+  return i < n ? i : n;
+}
+
+
+static void annotate
+(
+  DSO_DECODE* Decode,
+  int Start,
+  int End,
+  int Value,
+  int Type,
+  int Flags
+)
+{
+  DECODE_ANNOT* a;
+
+  if(Decode->Annotations == DECODE_MAX) return;
+  a = &Decode->Annot[Decode->Annotations];
+  a->Start = Start, a->End = End;
+  a->Value = (uint16_t)Value;
+  a->Type = (uint8_t)Type;
+  a->Flags = (uint8_t)Flags;
+  Decode->Annotations++;                      // publish once filled in
+}
+
+
+void decode_reset(DSO_DECODE* Decode)                  // start a new capture
+{
+  Decode->Length = 0;
+  Decode->Pos = 0;
+  Decode->State = IDLE;
+  Decode->Count = 0;
+  Decode->Shift = 0;
+  Decode->Last = -1;
+  Decode->Annotations = 0;
+}
+
+
+void decode_threshold            // append both channels to the bit streams
+(
+  DSO_DECODE* Decode,
+  const unsigned char* CH0,                    // interleaved waveforms from USB
+  int first,                           // sample index to append from, x64
+  int n                                              // samples per channel
+)
+{
+  const uint8_t L0 = Decode->Level[0];
+  const uint8_t L1 = Decode->Level[1];
+  const unsigned char* s;
+  uint64_t* b0;
+  uint64_t* b1;
+  uint64_t w0;
+  uint64_t w1;
+  int w;
+  int i;
+  int j;
+  int k;
+  int m;
+
+  if(Decode->Length + n > HT6022_1MB) n = HT6022_1MB - Decode->Length;
+  b0 = Decode->Bits[0] + (Decode->Length >> 6);
+  b1 = Decode->Bits[1] + (Decode->Length >> 6);
+  s = CH0 + 2 * first;
+
+  if((k = Decode->Length & 63) && n > 0)          // last word padded: top it up
+  {
+    m = n < 64 - k ? n : 64 - k;
+    w0 = b0[0] & ((1ULL << k) - 1);
+    w1 = b1[0] & ((1ULL << k) - 1);
+    for(i = k; i < 64; i++)
+    {
+      j = i - k < m ? i - k : m - 1;
+      w0 |= (uint64_t)(s[2 * j] >= L0) << i;
+      w1 |= (uint64_t)(s[2 * j + 1] >= L1) << i;
+    }
+    *b0++ = w0, *b1++ = w1;
+    s += 2 * m;
+    n -= m;
+    Decode->Length += m;
+  }
+
+  for(w = 0; w < n >> 6; w++, s += 128)     // fixed trip count: vectorises
+  {
+    for(i = 0, w0 = 0, w1 = 0; i < 64; i++)
+    {
+      w0 |= (uint64_t)(s[2 * i] >= L0) << i;
+      w1 |= (uint64_t)(s[2 * i + 1] >= L1) << i;
+    }
+    b0[w] = w0, b1[w] = w1;
+  }
+  if((k = n & 63))                      // pad last word with its last level
+  {
+    for(i = 0, w0 = 0, w1 = 0; i < 64; i++)
+    {
+      w0 |= (uint64_t)(s[2 * (i < k ? i : k - 1)] >= L0) << i;
+      w1 |= (uint64_t)(s[2 * (i < k ? i : k - 1) + 1] >= L1) << i;
+    }
+    b0[w] = w0, b1[w] = w1;
+  }
+  Decode->Length += n;
+}
+
+
+static bool uart(DSO_DECODE* Decode, int limit)   // 8N1 style, LSB first
+{
+  const uint64_t* b = Decode->Bits[Decode->Channel];
+  const double T = 1 / (Decode->Baud * Decode->Ts);   // samples per bit
+  const int bits = Decode->DataBits + (Decode->Parity != PARITY_NONE);
+  int n = Decode->Length;
+  int p = Decode->Pos;
+  int e;
+  int v;
+  int k;
+  int flags;
+  int parity;
+  bool wait = false;
+
+  while(p < limit)
+  {
+    if(!bit(b, p)) p = next_edge(b, p, n);    // wait for idle (mark) level
+    if(p >= n) break;
+    e = next_edge(b, p, n);                               // start bit edge
+    if(e >= limit)                  // resume from the mark before the edge
+    {
+      p = e - 1;
+      wait = e >= n;                                  // once there is more data
+      break;
+    }
+    if(e + (int)((bits + 2) * T) >= n)      // frame runs past data so far
+    {
+      p = e - 1;                     // retry from the mark before the edge
+      wait = true;
+      break;
+    }
+    if(bit(b, e + (int)(0.5 * T)))                  // glitch, not a start
+    {
+      p = e + 1;
+      continue;
+    }
+    for(k = 0, v = 0, parity = 0; k < Decode->DataBits; k++)
+      if(bit(b, e + (int)((k + 1.5) * T))) v |= 1 << k, parity ^= 1;
+    flags = 0;
+    if(Decode->Parity != PARITY_NONE)
+    {
+      parity ^= bit(b, e + (int)((Decode->DataBits + 1.5) * T));
+      if(parity != (Decode->Parity == PARITY_ODD)) flags |= DECODE_PARITY;
+    }
+    k = e + (int)((bits + 1.5) * T);                     // centre of stop bit
+    if(!bit(b, k)) flags |= DECODE_FRAME;
+    annotate(Decode, e, e + (int)((bits + 2) * T), v, ANNOT_DATA, flags);
+    p = k;
+  }
+  Decode->Pos = p < n ? p : n;
+  return !wait && Decode->Pos < n;
+}
+
+
+static bool i2c(DSO_DECODE* Decode, int limit)      // CH1 SCL, CH2 SDA
+{
+  const uint64_t* scl = Decode->Bits[0];
+  const uint64_t* sda = Decode->Bits[1];
+  int n = Decode->Length;
+  int p = Decode->Pos;
+  int c;
+  int d;
+
+  while(p < limit)
+  {
+    c = next_edge(scl, p, n);
+    d = next_edge(sda, p, n);
+    if(c >= n && d >= n) { p = n; break; }
+    if(d < c)                                         // SDA moved first ...
+    {
+      p = d;
+      if(!bit(scl, d)) continue;            // ... normal data change, or ...
+      if(!bit(sda, d))                                        // ... START
+      {
+        annotate(Decode, d, d, 0, ANNOT_START, 0);          // or repeated
+        Decode->State = ADDRESS;
+        Decode->Count = 0;
+        Decode->Shift = 0;
+      }
+      else                                                       // STOP
+      {
+        annotate(Decode, d, d, 0, ANNOT_STOP, 0);
+        Decode->State = IDLE;
+      }
+      continue;
+    }
+    p = c;
+    if(!bit(scl, c) || Decode->State == IDLE) continue;   // falling SCL
+    if(Decode->Count == 0) Decode->Begin = c;
+    if(Decode->Count++ < 8)                         // data, MSB first ...
+    {
+      Decode->Shift = Decode->Shift << 1 | bit(sda, c);
+      continue;
+    }
+    if(Decode->State == ADDRESS)                             // ... then ACK
+      annotate
+      (
+        Decode, Decode->Begin, c, Decode->Shift >> 1, ANNOT_ADDRESS,
+        (bit(sda, c) ? DECODE_NACK : 0) | (Decode->Shift & 1 ? DECODE_READ : 0)
+      );
+    else
+      annotate
+      (
+        Decode, Decode->Begin, c, Decode->Shift, ANNOT_DATA,
+        bit(sda, c) ? DECODE_NACK : 0
+      );
+    Decode->State = DATA;
+    Decode->Count = 0;
+    Decode->Shift = 0;
+  }
+  Decode->Pos = p;
+  return p < n;
+}
+
+
+static bool spi(DSO_DECODE* Decode, int limit)  // CH1 clock, CH2 MOSI or MISO
+{
+  const uint64_t* clk = Decode->Bits[0];
+  const uint64_t* dat = Decode->Bits[1];
+  const int gap = (int)(Decode->Gap / Decode->Ts);
+  const int active = !Decode->ClockFalling;
+  int n = Decode->Length;
+  int p = Decode->Pos;
+  int c;
+
+  while(p < limit)
+  {
+    c = next_edge(clk, p, n);
+    p = c;
+    if(c >= n) break;
+    if(bit(clk, c) != active) continue;
+    if(Decode->Last >= 0 && c - Decode->Last > gap)  // idle clock: new word
+      Decode->Count = 0;
+    Decode->Last = c;
+    if(Decode->Count == 0) Decode->Begin = c, Decode->Shift = 0;
+    Decode->Shift = Decode->Shift << 1 | bit(dat, c);
+    if(++Decode->Count == 8)
+    {
+      annotate(Decode, Decode->Begin, c, Decode->Shift, ANNOT_DATA, 0);
+      Decode->Count = 0;
+    }
+  }
+  Decode->Pos = p;
+  return p < n;
+}
+
+
+bool decode_run(DSO_DECODE* Decode, int n)     // true while more data waits
+{
+  int limit = Decode->Pos + n;
+
+  if(limit > Decode->Length) limit = Decode->Length;
+  if(Decode->Length == 0) return false;
+
+  switch(Decode->Protocol)
+  {
+    case DECODE_UART:
+      return uart(Decode, limit);
+    case DECODE_I2C:
+      return i2c(Decode, limit);
+    case DECODE_SPI:
+      return spi(Decode, limit);
+    default:
+      return false;
+  }
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,117 @@
+/*
+  DSOdecode.h: UART, I2C and SPI protocol decoders for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSODECODE_H
+#define DSODECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "HT6022.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define DECODE_WORDS  (HT6022_1MB / 64)         // one bit per sample, packed
+#define DECODE_MAX    4096                  // most annotations per capture
+#define DECODE_CHUNK  65536                // samples per incremental pass
+#define DECODE_SHOWN  64                  // most annotations drawn on screen
+
+#define DECODE_NACK   0x01                              // annotation flags
+#define DECODE_READ   0x02
+#define DECODE_PARITY 0x04
+#define DECODE_FRAME  0x08
+
+
+typedef enum
+{
+  DECODE_OFF,
+  DECODE_UART,                                   // on the selected channel
+  DECODE_I2C,                                        // CH1 SCL, CH2 SDA
+  DECODE_SPI                          // CH1 clock, CH2 data, no chip select
+} DECODE_PROTOCOL_TypeDef;
+
+typedef enum
+{
+  PARITY_NONE,
+  PARITY_EVEN,
+  PARITY_ODD
+} DECODE_PARITY_TypeDef;
+
+typedef enum
+{
+  ANNOT_DATA,
+  ANNOT_ADDRESS,
+  ANNOT_START,
+  ANNOT_STOP
+} DECODE_ANNOT_TypeDef;
+
+typedef struct
+{
+  int Start;                                 // sample index of first edge
+  int End;
+  uint16_t Value;
+  uint8_t Type;                                     // DECODE_ANNOT_TypeDef
+  uint8_t Flags;
+} DECODE_ANNOT;
+
+typedef struct DSO_DECODE
+{
+  DECODE_PROTOCOL_TypeDef Protocol;
+  int Channel;                                    // UART: 0 or 1 for data
+  double Baud;
+  int DataBits;                                                 // 5 to 9
+  DECODE_PARITY_TypeDef Parity;
+  bool ClockFalling;                     // SPI: data valid on falling edge
+  double Gap;                     // SPI: idle clock that ends a word, secs
+  double Threshold[2];                             // logic levels, volts
+  uint8_t Level[2];                           // same thresholds as codes
+  double Ts;                                    // sample interval, seconds
+  int Origin;                                // trigger sample, for display
+  int Length;                                       // samples thresholded
+  uint64_t Bits[2][DECODE_WORDS];                   // both channels, packed
+  int Pos;                              // decoder state persists from here
+  int State;
+  int Count;                                       // bits in Shift so far
+  int Shift;
+  int Begin;                                       // first edge of a word
+  int Last;                                      // previous SPI clock edge
+  int Annotations;
+  DECODE_ANNOT Annot[DECODE_MAX];
+} DSO_DECODE;
+
+
+extern DSO_DECODE Decode;
+
+extern void decode_reset(DSO_DECODE* Decode);
+extern void decode_threshold
+(
+  DSO_DECODE* Decode,
+  const unsigned char* CH0,                    // interleaved waveforms from USB
+  int first,                           // sample index to append from, x64
+  int n                                              // samples per channel
+);
+extern bool decode_run(DSO_DECODE* Decode, int n);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSODECODE_H
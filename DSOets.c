@@ -0,0 +1,142 @@
+/*
+  DSOets.c: equivalent time sampling, building a finely sampled picture
+  of a repetitive signal from many triggered acquisitions.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  The sample clock bears no relation to the signal, so each acquisition
+  samples it at a different fraction of a sample after the trigger.  With
+  that fraction known from trigger_time(), every sample in view has a
+  time after the crossing to far better than a sample, and is averaged
+  into the bin of a fine grid, ETS_RATE bins to a sample, that covers the
+  screen.  Over a few hundred acquisitions every bin fills, giving what a
+  sample rate ETS_RATE times faster would show of a repetitive signal.
+  Each bin is a running mean of its last ETS_DEPTH or so samples, so the
+  picture follows a slowly changing signal.
+
+  The worker adds every acquisition it accepts, not just those the GUI
+  gets round to showing.  Only the samples in view are touched, at most
+  ETS_BINS of them, so this costs far less than the USB transfer.  Bins
+  not yet filled are shown interpolated between their neighbours.
+*/
+
+
+#include <math.h>
+#include <string.h>
+#include "DSOets.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+void ets_clear(DSO_ETS* Ets)                                     // start afresh
+{
+  Ets->Frames = 0;
+  memset(Ets->Count, 0, sizeof(Ets->Count));
+}
+
+
+bool ets_grid                 // bins to cover the screen, cleared if they moved
+(
+  DSO_ETS* Ets,
+  double t0,                       // time of the left edge after the trigger, s
+  double Tdiv,
+  double Ts                                                     // sample period
+)
+{
+  double dt = Ts / ETS_RATE;
+  int bins;
+
+  if(dt * (ETS_BINS - 1) < 10 * Tdiv) dt = 10 * Tdiv / (ETS_BINS - 1);
+  bins = (int)ceil(10 * Tdiv / dt) + 1;
+  if(bins > ETS_BINS) bins = ETS_BINS;
+  if(Ets->t0 == t0 && Ets->dt == dt && Ets->Bins == bins) return false;
+  Ets->t0 = t0;
+  Ets->dt = dt;
+  Ets->Bins = bins;
+  ets_clear(Ets);
+  return true;
+}
+
+
+void ets_add                               // one triggered acquisition, as read
+(
+  DSO_ETS* Ets,
+  const unsigned char* Data,                                      // interleaved
+  int Samples,
+  double Crossing,                // trigger crossing, fractional sample of Data
+  double Ts
+)
+{
+  const double r = Ts / Ets->dt;                              // bins per sample
+  const double b0 = -Ets->t0 / Ets->dt - Crossing * r;        // bin of sample 0
+  double b;
+  int first;
+  int last;
+  int n;
+  int k;
+  int s;
+
+  first = (int)ceil((-0.5 - b0) / r);                     // samples in view ...
+  last = (int)floor((Ets->Bins - 0.5 - b0) / r);
+  if(first < 8) first = 8;                          // ... but never the rubbish
+  if(last > Samples - 1) last = Samples - 1;
+
+  for(s = first; s <= last; s++)
+  {
+    b = b0 + s * r + 0.5;
+    k = (int)b;
+    if(k < 0 || k >= Ets->Bins) continue;                 // rounding, at an end
+    n = Ets->Count[k] < ETS_DEPTH ? ++Ets->Count[k] : ETS_DEPTH;
+    Ets->Mean[0][k] += (Data[2 * s] - Ets->Mean[0][k]) / n;
+    Ets->Mean[1][k] += (Data[2 * s + 1] - Ets->Mean[1][k]) / n;
+  }
+  Ets->Frames++;
+}
+
+
+int ets_trace              // bins as codes, gaps interpolated: 0 if none filled
+(
+  const DSO_ETS* Ets,
+  int channel,                                                         // 0 or 1
+  float* CH                                                       // Bins points
+)
+{
+  const float* m = Ets->Mean[channel];
+  int prev = -1;                                        // last bin with samples
+  int k;
+  int i;
+
+  for(k = 0; k < Ets->Bins; k++)
+  {
+    if(!Ets->Count[k]) continue;
+    CH[k] = m[k];
+    for(i = prev + 1; i < k; i++)                       // gap since, or lead in
+      CH[i] = prev < 0 ? m[k] :
+        m[prev] + (m[k] - m[prev]) * (i - prev) / (k - prev);
+    prev = k;
+  }
+  if(prev < 0) return 0;
+  for(i = prev + 1; i < Ets->Bins; i++) CH[i] = m[prev];
+  return Ets->Bins;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,63 @@
+/*
+  DSOets.h: equivalent time sampling for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOETS_H
+#define DSOETS_H
+
+#include <stdbool.h>
+#include "HT6022.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define ETS_BINS HT6022_1KB                    // at most, shown as trace points
+#define ETS_RATE 20                      // bins per sample, 960MSa/s at 48MSa/s
+#define ETS_DEPTH 16                      // acquisitions averaged into each bin
+
+
+typedef struct DSO_ETS
+{
+  double t0;                      // time of bin 0 after the trigger crossing, s
+  double dt;                                                        // s per bin
+  int Bins;
+  unsigned int Frames;                             // acquisitions since cleared
+  unsigned short Count[ETS_BINS];               // samples in each, to ETS_DEPTH
+  float Mean[2][ETS_BINS];                                 // codes, CH1 and CH2
+} DSO_ETS;
+
+
+extern void ets_clear(DSO_ETS* Ets);
+extern bool ets_grid(DSO_ETS* Ets, double t0, double Tdiv, double Ts);
+extern void ets_add
+(
+  DSO_ETS* Ets,
+  const unsigned char* Data,
+  int Samples,
+  double Crossing,
+  double Ts
+);
+extern int ets_trace(const DSO_ETS* Ets, int channel, float* CH);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOETS_H
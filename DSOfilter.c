@@ -0,0 +1,291 @@
+/*
+  DSOfilter.c: low pass, high pass and notch filters applied to the
+  de-interleaved channel data before display.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  IIR filters are Butterworth cascades of RBJ biquads run in double
+  precision as the poles get very close to the unit circle when the corner
+  frequency is a small fraction of 16MSa/s.  FIR filters are Hamming
+  windowed sinc kernels centred on the output sample so they introduce no
+  delay.  Samples are filtered about mid scale (code 128) so that high pass
+  output stays centred on the trace.  The FIR inner loop runs over a whole
+  block for each tap in turn which the compiler turns into packed single
+  precision multiply-adds.
+*/
+
+
+#include <string.h>
+#include <math.h>
+#include "DSOfilter.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+DSO_FILTER Filter1 = {.Type = FILTER_OFF, .Fc = 1e6, .Q = 5.0, .Order = 4};
+DSO_FILTER Filter2 = {.Type = FILTER_OFF, .Fc = 1e6, .Q = 5.0, .Order = 4};
+
+
+static void biquad                                  // RBJ cookbook sections
+(
+  FILTER_BIQUAD* bq,
+  FILTER_TYPE_TypeDef Type,
+  double w0,                                  // normalised angular frequency
+  double Q
+)
+{
+  double alpha = sin(w0) / (2 * Q);
+  double c = cos(w0);
+  double a0 = 1 + alpha;
+
+  switch(Type)
+  {
+    case FILTER_HIGHPASS:
+      bq->b0 = (1 + c) / 2, bq->b1 = -(1 + c), bq->b2 = (1 + c) / 2;
+      break;
+    case FILTER_NOTCH:
+      bq->b0 = 1, bq->b1 = -2 * c, bq->b2 = 1;
+      break;
+    default:
+      bq->b0 = (1 - c) / 2, bq->b1 = 1 - c, bq->b2 = (1 - c) / 2;
+      break;
+  }
+  bq->b0 /= a0, bq->b1 /= a0, bq->b2 /= a0;
+  bq->a1 = -2 * c / a0;
+  bq->a2 = (1 - alpha) / a0;
+  bq->z1 = bq->z2 = 0;
+}
+
+
+static void sinc            // add (or subtract) windowed sinc low pass kernel
+(
+  float* h,
+  int taps,
+  double f,                                 // cut off as fraction of fs
+  double sign
+)
+{
+  double v[FILTER_TAPS];
+  double sum = 0;
+  int M = (taps - 1) / 2;
+  int n;
+
+  for(n = 0; n < taps; n++)
+  {
+    v[n] = n == M ? 2 * f : sin(2 * M_PI * f * (n - M)) / (M_PI * (n - M));
+    v[n] *= 0.54 - 0.46 * cos(2 * M_PI * n / (taps - 1));          // Hamming
+    sum += v[n];
+  }
+  for(n = 0; n < taps; n++) h[n] += sign * v[n] / sum;          // unity at DC
+}
+
+
+void filter_design(DSO_FILTER* Filter, double Ts)  // recalculate coefficients
+{
+  double f;                                     // frequency as fraction of fs
+  double bw;
+  int N;
+  int k;
+
+  Filter->Ts = Ts;
+  Filter->Sections = 0;
+  Filter->Taps = 0;
+  if(Filter->Type == FILTER_OFF) return;
+
+  f = Filter->Fc * Ts;
+  if(f > 0.45) f = 0.45;
+  if(f < 1e-6) f = 1e-6;
+
+  if(Filter->Design == FILTER_IIR)
+  {
+    if(Filter->Type == FILTER_NOTCH)
+    {
+      Filter->Sections = 1;
+      biquad(&Filter->Biquad[0], FILTER_NOTCH, 2 * M_PI * f, Filter->Q);
+      return;
+    }
+    N = Filter->Order / 2;                       // Butterworth pole pairs
+    if(N < 1) N = 1;
+    if(N > FILTER_SECTIONS) N = FILTER_SECTIONS;
+    Filter->Sections = N;
+    for(k = 0; k < N; k++)
+      biquad
+      (
+        &Filter->Biquad[k], Filter->Type, 2 * M_PI * f,
+        1 / (2 * cos(M_PI * (2 * k + 1) / (4 * N)))
+      );
+    return;
+  }
+
+  N = Filter->Order | 1;                                         // odd length
+  if(N < 3) N = 3;
+  if(N > FILTER_TAPS) N = FILTER_TAPS;
+  Filter->Taps = N;
+  memset(Filter->h, 0, sizeof(Filter->h));
+
+  switch(Filter->Type)
+  {
+    case FILTER_LOWPASS:
+      sinc(Filter->h, N, f, 1);
+      break;
+    case FILTER_HIGHPASS:                               // spectral inversion
+      sinc(Filter->h, N, f, -1);
+      Filter->h[(N - 1) / 2] += 1;
+      break;
+    default:                                   // band stop: LP(f1) + HP(f2)
+      bw = f / (2 * Filter->Q);
+      sinc(Filter->h, N, f - bw, 1);
+      sinc(Filter->h, N, f + bw > 0.49 ? 0.49 : f + bw, -1);
+      Filter->h[(N - 1) / 2] += 1;
+      break;
+  }
+}
+
+
+static inline float sample(DSO_FILTER* Filter, int i)  // clamped input sample
+{
+  if(i < 0) i = 0;
+  if(i >= Filter->Depth) i = Filter->Depth - 1;
+  return Filter->Src[Filter->Stride * i];
+}
+
+
+static void load(DSO_FILTER* Filter, float* x, int n)  // de-interleave block
+{
+  const unsigned char* src = Filter->Src + Filter->Stride * Filter->Pos;
+  const int s = Filter->Stride;
+  int i;
+
+  if(Filter->Pos >= 0 && Filter->Pos + n <= Filter->Depth)
+    for(i = 0; i < n; i++) x[i] = src[s * i] - 128.0f;
+  else
+    for(i = 0; i < n; i++) x[i] = sample(Filter, Filter->Pos + i) - 128.0f;
+  Filter->Pos += n;
+}
+
+
+static void iir(DSO_FILTER* Filter, float* x, int n)   // in place, section wise
+{
+  FILTER_BIQUAD* bq;
+  double y;
+  double z1;
+  double z2;
+  int s;
+  int i;
+
+  for(s = 0; s < Filter->Sections; s++)
+  {
+    bq = &Filter->Biquad[s];
+    z1 = bq->z1, z2 = bq->z2;
+    for(i = 0; i < n; i++)
+    {
+      y = bq->b0 * x[i] + z1;
+      z1 = bq->b1 * x[i] - bq->a1 * y + z2;
+      z2 = bq->b2 * x[i] - bq->a2 * y;
+      x[i] = y;
+    }
+    bq->z1 = z1, bq->z2 = z2;
+  }
+}
+
+
+void filter_start               // prime filter state ahead of the first output
+(
+  DSO_FILTER* Filter,
+  const unsigned char* Src,                  // first sample of channel, as read
+  int Stride,                                      // bytes from one to the next
+  int first,                                 // sample index of first output
+  int MemDepth                                         // samples in the channel
+)
+{
+  FILTER_BIQUAD* bq;
+  double u;
+  double y;
+  int n;
+  int s;
+
+  Filter->Src = Src;
+  Filter->Stride = Stride;
+  Filter->Depth = MemDepth;
+
+  if(Filter->Taps)                    // FIR: history of preceding samples ...
+  {
+    Filter->Pos = first + (Filter->Taps - 1) / 2 - (Filter->Taps - 1);
+    load(Filter, Filter->x, Filter->Taps - 1);    // ... half a kernel ahead
+    return;
+  }
+
+  Filter->Pos = first > FILTER_WARMUP ? first - FILTER_WARMUP : 0;
+
+  u = sample(Filter, Filter->Pos) - 128.0;    // steady state for initial value
+  for(s = 0; s < Filter->Sections; s++)
+  {
+    bq = &Filter->Biquad[s];
+    y = u * (bq->b0 + bq->b1 + bq->b2) / (1 + bq->a1 + bq->a2);
+    bq->z2 = bq->b2 * u - bq->a2 * y;
+    bq->z1 = bq->b1 * u - bq->a1 * y + bq->z2;
+    u = y;
+  }
+
+  while(Filter->Pos < first)                        // then settle on real data
+  {
+    n = first - Filter->Pos;
+    if(n > FILTER_BLOCK) n = FILTER_BLOCK;
+    load(Filter, Filter->x, n);
+    iir(Filter, Filter->x, n);
+  }
+}
+
+
+void filter_run(DSO_FILTER* Filter, float* out, int n)    // n filtered samples
+{
+  const int T = Filter->Taps - 1;
+  float* x = Filter->x;
+  float* restrict y = out;
+  const float* restrict xk;
+  float h;
+  int i;
+  int k;
+
+  if(n > FILTER_BLOCK) n = FILTER_BLOCK;
+
+  if(Filter->Taps)
+  {
+    load(Filter, x + T, n);
+    for(i = 0; i < n; i++) y[i] = 0;
+    for(k = 0; k <= T; k++)                       // tap outer: vectorises on i
+    {
+      h = Filter->h[k];
+      xk = x + T - k;
+      for(i = 0; i < n; i++) y[i] += h * xk[i];
+    }
+    memmove(x, x + n, T * sizeof(float));                   // keep history
+  }
+  else
+  {
+    load(Filter, out, n);
+    iir(Filter, out, n);                   // no sections: straight through
+  }
+  for(i = 0; i < n; i++) y[i] += 128.0f;   // filters work about mid scale code
+}
+
+#ifdef __cplusplus
+    }
+#endif
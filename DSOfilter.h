@@ -0,0 +1,93 @@
+/*
+  DSOfilter.h: per channel digital filters for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOFILTER_H
+#define DSOFILTER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define FILTER_SECTIONS 4                      // biquads: up to 8th order IIR
+#define FILTER_TAPS   127                             // longest FIR kernel
+#define FILTER_BLOCK 4096      // samples per block, at least one whole ...
+                              // ... display interval as SubSample <= 1024;
+                            // use FILTER_BLOCK / SubSample whole intervals
+#define FILTER_WARMUP 512          // IIR settling samples before first output
+
+
+typedef enum
+{
+  FILTER_OFF,
+  FILTER_LOWPASS,
+  FILTER_HIGHPASS,
+  FILTER_NOTCH
+} FILTER_TYPE_TypeDef;
+
+typedef enum
+{
+  FILTER_IIR,                                      // cascade of biquads
+  FILTER_FIR                            // Hamming windowed sinc, zero phase
+} FILTER_DESIGN_TypeDef;
+
+typedef struct
+{
+  double b0, b1, b2, a1, a2;                        // normalised so a0 = 1
+  double z1, z2;                           // transposed direct form II state
+} FILTER_BIQUAD;
+
+typedef struct DSO_FILTER
+{
+  FILTER_TYPE_TypeDef Type;
+  FILTER_DESIGN_TypeDef Design;
+  double Fc;                                 // corner or notch frequency, Hz
+  double Q;                                          // notch quality factor
+  int Order;                             // IIR order or number of FIR taps
+  double Ts;                        // sample interval used for coefficients
+  int Sections;
+  FILTER_BIQUAD Biquad[FILTER_SECTIONS];
+  int Taps;
+  float h[FILTER_TAPS];                                 // FIR coefficients
+  float x[FILTER_TAPS - 1 + FILTER_BLOCK];        // FIR history and input
+  const unsigned char* Src;             // channel being read, in the USB buffer
+  int Stride;                                       // bytes between its samples
+  int Pos;                                   // next input sample to read
+  int Depth;                                    // samples available in Src
+} DSO_FILTER;
+
+
+extern DSO_FILTER Filter1, Filter2;
+
+extern void filter_design(DSO_FILTER* Filter, double Ts);
+extern void filter_start
+(
+  DSO_FILTER* Filter,
+  const unsigned char* Src,                  // first sample of channel, as read
+  int Stride,                                      // bytes from one to the next
+  int first,                                 // sample index of first output
+  int MemDepth                                         // samples in the channel
+);
+extern void filter_run(DSO_FILTER* Filter, float* out, int n);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOFILTER_H
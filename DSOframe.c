@@ -0,0 +1,254 @@
+/*
+  DSOframe.c: acquisition frames handed from the USB reads to the display
+  without copying.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Each worker owns a small pool of frames, each wrapping one of its USB
+  transfer buffers.  The worker holds a reference to the frame it is
+  reading and to the latest one it has accepted; the GUI holds one to the
+  frame on screen.  A frame goes back into the pool when the last of these
+  is released, so whoever is looking at a capture sees the bytes as read
+  from USB, never a later capture written over them.  Formatters read each
+  channel in place through a FRAME_CHANNEL, a pointer and a stride into
+  the interleaved transfer buffer.
+
+  Buffers are allocated by the worker as it takes a free frame, sized in
+  whole pages to the MemDepth about to be read, so 1KB captures no longer
+  sit in 2MB arrays and the pool may grow should something keep hold of
+  frames.  Where allowed, 1MB captures go in a single 2MB hugepage and
+  buffers are locked so a transfer never waits on a page fault.  Better
+  still, libusb device memory is an mmap of usbfs which the kernel reads
+  into directly rather than via its own bounce buffer.  Each option falls
+  back quietly, in that order, to ordinary page aligned heap and the
+  outcome is counted for frame_pool_stats().
+*/
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "DSOframe.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static int pages(int Bytes)                         // rounded up to whole pages
+{
+  long page = sysconf(_SC_PAGESIZE);
+
+  return (int)((Bytes + page - 1) / page * page);
+}
+
+
+static void count(int* Counter)               // worker's tally, read by the GUI
+{
+  __atomic_add_fetch(Counter, 1, __ATOMIC_RELAXED);
+}
+
+
+static void buffer_free(DSO_FRAME* Frame)
+{
+  if(Frame->Locked) munlock(Frame->Data, Frame->Size);
+  switch(Frame->Mem)
+  {
+    case FRAME_MEM_USB:               // all libusb_dev_mem_free() does, and ...
+    case FRAME_MEM_HUGETLB:                    // ... Owner may be closed by now
+      munmap(Frame->Data, Frame->Size);
+      break;
+    case FRAME_MEM_PAGES:
+    case FRAME_MEM_THP:
+      free(Frame->Data);
+      break;
+    default:
+      break;
+  }
+  Frame->Data = NULL;
+  __atomic_store_n(&Frame->Size, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&Frame->Mem, FRAME_MEM_NONE, __ATOMIC_RELAXED);
+  __atomic_store_n(&Frame->Locked, false, __ATOMIC_RELAXED);
+  Frame->Owner = NULL;
+}
+
+
+static bool buffer_alloc
+(
+  DSO_FRAME_POOL* Pool,
+  DSO_FRAME* Frame,
+  int Bytes,
+  libusb_device_handle* Usb                           // NULL while disconnected
+)
+{
+  int size = pages(Bytes);
+  void* p = NULL;
+  FRAME_MEM_TypeDef mem = FRAME_MEM_PAGES;
+  bool locked = false;
+
+  if((Pool->Options & FRAME_USB) && Usb)
+  {
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    p = libusb_dev_mem_alloc(Usb, size);
+#endif
+    if(p) mem = FRAME_MEM_USB;
+    else count(&Pool->Fallbacks);                    // old kernel, or not Linux
+  }
+  if(!p && (Pool->Options & FRAME_HUGE) && size >= FRAME_HUGEPAGE)
+  {
+    size = (size + FRAME_HUGEPAGE - 1) / FRAME_HUGEPAGE * FRAME_HUGEPAGE;
+#ifdef MAP_HUGETLB
+    p = mmap
+    (
+      NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+    );
+    if(p == MAP_FAILED) p = NULL;                      // none reserved, usually
+    else mem = FRAME_MEM_HUGETLB;
+#endif
+    if(!p && posix_memalign(&p, FRAME_HUGEPAGE, size) == 0)
+    {
+#ifdef MADV_HUGEPAGE
+      madvise(p, size, MADV_HUGEPAGE);
+#endif
+      mem = FRAME_MEM_THP;
+    }
+  }
+  if(!p && posix_memalign(&p, pages(1), size) != 0) return false;
+
+  if(mem != FRAME_MEM_USB)                           // usbfs memory is resident
+  {
+    if((Pool->Options & FRAME_LOCK) && mlock(p, size) == 0) locked = true;
+    else if(Pool->Options & FRAME_LOCK) count(&Pool->Fallbacks); // RLIMIT
+    memset(p, 0, size);                        // fault in before the first read
+  }
+
+  Frame->Data = (unsigned char*)p;
+  Frame->Owner = Usb;                 // tried for, so not retried until it goes
+  __atomic_store_n(&Frame->Size, size, __ATOMIC_RELAXED);
+  __atomic_store_n(&Frame->Mem, mem, __ATOMIC_RELAXED);
+  __atomic_store_n(&Frame->Locked, locked, __ATOMIC_RELAXED);
+  count(&Pool->Allocs);
+  return true;
+}
+
+
+void frame_pool_init(DSO_FRAME_POOL* Pool, unsigned int Options)
+{
+  memset(Pool, 0, sizeof(*Pool));                       // buffers come with use
+  Pool->Count = FRAME_POOL;
+  Pool->Options = Options;
+}
+
+
+static bool fits(const DSO_FRAME* Frame, int Bytes, libusb_device_handle* Usb)
+{
+  return Frame->Data && Frame->Size == pages(Bytes) && Frame->Owner == Usb;
+}
+
+
+DSO_FRAME* frame_get                        // frame to read into, one reference
+(
+  DSO_FRAME_POOL* Pool,
+  DSO_FRAME* Fill,                     // still held from last read, may be NULL
+  int Bytes,                                           // of buffer it must have
+  libusb_device_handle* Usb                      // device to read, NULL if none
+)
+{
+  DSO_FRAME* f = NULL;
+  int i;
+
+  if(!(Pool->Options & FRAME_USB)) Usb = NULL;     // device change is no matter
+  if(Fill && fits(Fill, Bytes, Usb)) return Fill;
+  frame_release(Fill);                             // MemDepth or device changed
+
+  for(i = 0; i < Pool->Count && !f; i++)     // only the owning worker takes ...
+    if(__atomic_load_n(&Pool->Frame[i].Refs, __ATOMIC_ACQUIRE) == 0)
+      f = &Pool->Frame[i];
+  if(!f && Pool->Count < FRAME_POOL_MAX)              // someone is keeping hold
+  {
+    f = &Pool->Frame[Pool->Count];
+    __atomic_store_n(&Pool->Count, Pool->Count + 1, __ATOMIC_RELAXED);
+  }
+  if(!f)
+  {
+    count(&Pool->Waits);
+    return NULL;
+  }
+  if(!fits(f, Bytes, Usb))                                    // resize or remap
+  {
+    if(f->Data) buffer_free(f);
+    if(!buffer_alloc(Pool, f, Bytes, Usb)) return NULL;
+  }
+  __atomic_store_n(&f->Refs, 1, __ATOMIC_RELAXED);       // ... so none can race
+  return f;
+}
+
+
+void frame_retain(DSO_FRAME* Frame)
+{
+  __atomic_add_fetch(&Frame->Refs, 1, __ATOMIC_RELAXED);
+}
+
+
+void frame_release(DSO_FRAME* Frame)    // back to the pool after last release
+{
+  if(Frame) __atomic_sub_fetch(&Frame->Refs, 1, __ATOMIC_RELEASE);
+}
+
+
+void frame_pool_stats                             // from any thread, as it goes
+(
+  DSO_FRAME_POOL* Pool,
+  FRAME_POOL_STATS* Stats
+)
+{
+  DSO_FRAME* f;
+  int i;
+
+  memset(Stats, 0, sizeof(*Stats));
+  Stats->Frames = __atomic_load_n(&Pool->Count, __ATOMIC_RELAXED);
+  for(i = 0; i < Stats->Frames; i++)
+  {
+    f = &Pool->Frame[i];
+    if(__atomic_load_n(&f->Refs, __ATOMIC_RELAXED)) Stats->Held++;
+    Stats->Bytes += __atomic_load_n(&f->Size, __ATOMIC_RELAXED);
+    Stats->Mem[__atomic_load_n(&f->Mem, __ATOMIC_RELAXED)]++;
+    if(__atomic_load_n(&f->Locked, __ATOMIC_RELAXED)) Stats->Locked++;
+  }
+  Stats->Allocs = __atomic_load_n(&Pool->Allocs, __ATOMIC_RELAXED);
+  Stats->Fallbacks = __atomic_load_n(&Pool->Fallbacks, __ATOMIC_RELAXED);
+  Stats->Waits = __atomic_load_n(&Pool->Waits, __ATOMIC_RELAXED);
+}
+
+
+FRAME_CHANNEL frame_channel(const DSO_FRAME* Frame, int channel)     // 0 or 1
+{
+  FRAME_CHANNEL c;
+
+  c.Data = Frame->Data + channel;
+  c.Stride = 2;
+  c.Length = Frame->Settings.Dso.MemDepth;
+  return c;
+}
+
+#ifdef __cplusplus
+    }
+#endif
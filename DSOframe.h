@@ -0,0 +1,110 @@
+/*
+  DSOframe.h: reference counted acquisition frames for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOFRAME_H
+#define DSOFRAME_H
+
+#include "DSOsettings.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define FRAME_POOL 3            // being read, latest, on screen: per worker
+#define FRAME_POOL_MAX 8                  // grown to this if all are still held
+#define FRAME_HUGEPAGE 0x200000                 // 2MB, as used for 1MB captures
+
+#define FRAME_HUGE 0x01                     // Options: hugepages where they fit
+#define FRAME_LOCK 0x02                            // mlock() so never paged out
+#define FRAME_USB 0x04              // libusb device memory, read into by kernel
+#define FRAME_DEFAULT (FRAME_HUGE | FRAME_LOCK | FRAME_USB)   // each if allowed
+
+
+typedef enum
+{
+  FRAME_MEM_NONE,                                            // no buffer as yet
+  FRAME_MEM_PAGES,                                     // page aligned from heap
+  FRAME_MEM_THP,                 // 2MB aligned, advised as transparent hugepage
+  FRAME_MEM_HUGETLB,                                  // from reserved hugepages
+  FRAME_MEM_USB                       // libusb_dev_mem_alloc(), usbfs zero copy
+} FRAME_MEM_TypeDef;
+
+
+typedef struct DSO_FRAME
+{
+  unsigned char* Data;              // USB transfer buffer, read in place
+  int Size;                                                // bytes, whole pages
+  FRAME_MEM_TypeDef Mem;                                 // where Data came from
+  bool Locked;                                          // mlock()ed into memory
+  libusb_device_handle* Owner;                  // allocated while this was open
+  int Refs;                              // free for the next read when zero
+  DSO_SETTINGS Settings;                 // as pinned when Data was read
+  int TriggerPoint;                       // in terms of sample index position
+  unsigned int Sequence;                    // worker's Frame count as read
+} DSO_FRAME;
+
+typedef struct
+{
+  DSO_FRAME Frame[FRAME_POOL_MAX];
+  int Count;                            // frames in use so far, from FRAME_POOL
+  unsigned int Options;                                       // FRAME_HUGE etc.
+  int Allocs;                                     // buffers (re)sized or mapped
+  int Fallbacks;                   // option asked for but refused by the system
+  int Waits;                               // reads delayed with all frames held
+} DSO_FRAME_POOL;
+
+typedef struct                             // snapshot for display, see worker.h
+{
+  int Frames;
+  int Held;                                      // by the worker, GUI or others
+  int Bytes;                                                      // all buffers
+  int Mem[FRAME_MEM_USB + 1];                             // frames of each kind
+  int Locked;
+  int Allocs;
+  int Fallbacks;
+  int Waits;
+} FRAME_POOL_STATS;
+
+typedef struct
+{
+  const unsigned char* Data;                     // first sample of channel
+  int Stride;                                  // bytes from one to the next
+  int Length;                                                     // samples
+} FRAME_CHANNEL;
+
+
+extern void frame_pool_init(DSO_FRAME_POOL* Pool, unsigned int Options);
+extern DSO_FRAME* frame_get
+(
+  DSO_FRAME_POOL* Pool,
+  DSO_FRAME* Fill,
+  int Bytes,
+  libusb_device_handle* Usb
+);
+extern void frame_pool_stats(DSO_FRAME_POOL* Pool, FRAME_POOL_STATS* Stats);
+extern void frame_retain(DSO_FRAME* Frame);
+extern void frame_release(DSO_FRAME* Frame);
+extern FRAME_CHANNEL frame_channel(const DSO_FRAME* Frame, int channel);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOFRAME_H
@@ -0,0 +1,371 @@
+/*
+  DSOlog.c: long term data logger, reducing the streamed samples to
+  statistics for each interval.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  While rolling, each transfer is also reduced to the minimum, maximum
+  and sum of each channel, in one pass of plain block loops which the
+  compiler vectorises, and added to the record for the current interval.
+  Once the wall clock passes the end of the interval the record, 32 bytes
+  of codes, is appended to the log and flushed, so at one a second a day
+  is under 3MB and a crash loses at most the interval in progress.  A
+  record ends early should an input range change so that each is in one
+  range; the header gives volts per code and zero for every range.
+
+  Every LOG_BLOCK records a summary in volts is appended to a second file,
+  path.idx.  log_query() takes whole blocks inside the range asked for
+  from there and reads records only for the blocks at either end, so a
+  month long log is summarised from a few hundred index entries.  Nothing
+  is held in memory but the record and block being built.
+*/
+
+
+#include <string.h>
+#include <float.h>
+#include <time.h>
+#include "DSOlog.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static const char Magic[8] = "DSOLOG";
+
+
+static double now(void)                                 // Unix time, in seconds
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_REALTIME, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static float volts                   // of a code read in range IR on channel ch
+(
+  const LOG_HEADER* Header,
+  int ch,
+  uint8_t IR,
+  float code
+)
+{
+  int r;
+
+  for(r = 0; r < LOG_RANGES - 1; r++) if(Header->Range[r] == IR) break;
+  return (code - Header->Zero[ch][r]) * Header->Volts[ch][r];
+}
+
+
+static void reduce                  // minimum, maximum and sum of both channels
+(
+  const unsigned char* p,                          // CH1 and CH2 pairs, as read
+  int n,                                                   // samples, up to 16M
+  uint8_t* Min,
+  uint8_t* Max,
+  uint64_t* Sum
+)
+{
+  unsigned char lo0 = Min[0], hi0 = Max[0];
+  unsigned char lo1 = Min[1], hi1 = Max[1];
+  uint32_t s0 = 0;
+  uint32_t s1 = 0;
+  int i;
+
+  for(i = 0; i < 2 * n; i += 2)
+  {
+    lo0 = p[i] < lo0 ? p[i] : lo0;
+    hi0 = p[i] > hi0 ? p[i] : hi0;
+    lo1 = p[i+1] < lo1 ? p[i+1] : lo1;
+    hi1 = p[i+1] > hi1 ? p[i+1] : hi1;
+    s0 += p[i];
+    s1 += p[i+1];
+  }
+  Min[0] = lo0, Max[0] = hi0, Sum[0] += s0;
+  Min[1] = lo1, Max[1] = hi1, Sum[1] += s1;
+}
+
+
+static void block_start(LOG_INDEX* Block, double* Sum)
+{
+  memset(Block, 0, sizeof(*Block));
+  Block->Min[0] = Block->Min[1] = FLT_MAX;
+  Block->Max[0] = Block->Max[1] = -FLT_MAX;
+  Sum[0] = Sum[1] = 0;
+}
+
+
+static void block_write(DSO_LOG* Log)                     // summary to path.idx
+{
+  LOG_INDEX* b = &Log->Block;
+
+  if(!b->Records) return;
+  b->Mean[0] = Log->BlockSum[0] / b->Samples;
+  b->Mean[1] = Log->BlockSum[1] / b->Samples;
+  if(Log->Index)
+  {
+    fwrite(b, sizeof(*b), 1, Log->Index);
+    fflush(Log->Index);
+  }
+  block_start(b, Log->BlockSum);
+}
+
+
+static void merge                          // one record into a summary in volts
+(
+  const LOG_HEADER* Header,
+  const LOG_RECORD* r,
+  float* Min,
+  float* Max,
+  double* Sum                                             // volts times samples
+)
+{
+  float v;
+  int ch;
+
+  for(ch = 0; ch < 2; ch++)
+  {
+    v = volts(Header, ch, r->Range[ch], r->Min[ch]);
+    if(v < Min[ch]) Min[ch] = v;
+    v = volts(Header, ch, r->Range[ch], r->Max[ch]);
+    if(v > Max[ch]) Max[ch] = v;
+    v = volts(Header, ch, r->Range[ch], r->Mean[ch]);
+    Sum[ch] += (double)v * r->Samples;
+  }
+}
+
+
+static void record_write(DSO_LOG* Log)           // interval complete: append it
+{
+  LOG_RECORD* r = &Log->Record;
+  LOG_INDEX* b = &Log->Block;
+
+  if(!r->Samples) return;
+  r->Mean[0] = (float)Log->Sum[0] / r->Samples;
+  r->Mean[1] = (float)Log->Sum[1] / r->Samples;
+  fwrite(r, sizeof(*r), 1, Log->Data);
+  fflush(Log->Data);                                   // a crash loses only one
+
+  if(!b->Records) b->t = r->t, b->First = Log->Records;
+  merge(&Log->Header, r, b->Min, b->Max, Log->BlockSum);
+  b->Samples += r->Samples;
+  b->End = r->t;
+  b->Records++;
+  Log->Records++;
+  if(b->Records == LOG_BLOCK) block_write(Log);
+
+  r->Samples = 0;
+}
+
+
+int log_open                                   // start a log, 0 if it could not
+(
+  DSO_LOG* Log,
+  const char* path,
+  double Interval,                                         // seconds per record
+  double Ts,
+  const HT6022_IRTypeDef Range[LOG_RANGES],              // each input range ...
+  const float Volts[2][LOG_RANGES],                    // ... volts per code ...
+  const float Zero[2][LOG_RANGES]                   // ... and code for 0V in it
+)
+{
+  char index[4096];
+  int r;
+
+  memset(Log, 0, sizeof(*Log));
+  if(strlen(path) + 5 > sizeof(index)) return 0;
+  strcpy(index, path);
+  strcat(index, ".idx");
+  if((Log->Data = fopen(path, "wb")) == NULL) return 0;
+  Log->Index = fopen(index, "wb");             // logged without, should it fail
+
+  memcpy(Log->Header.Magic, Magic, sizeof(Magic));
+  Log->Header.Version = LOG_VERSION;
+  Log->Header.RecordSize = sizeof(LOG_RECORD);
+  Log->Header.Start = now();
+  Log->Header.Interval = Interval;
+  Log->Header.Ts = Ts;
+  for(r = 0; r < LOG_RANGES; r++)
+  {
+    Log->Header.Range[r] = Range[r];
+    Log->Header.Volts[0][r] = Volts[0][r];
+    Log->Header.Volts[1][r] = Volts[1][r];
+    Log->Header.Zero[0][r] = Zero[0][r];
+    Log->Header.Zero[1][r] = Zero[1][r];
+  }
+  fwrite(&Log->Header, sizeof(Log->Header), 1, Log->Data);
+  fflush(Log->Data);
+
+  Log->Next = Interval;
+  block_start(&Log->Block, Log->BlockSum);
+  return 1;
+}
+
+
+void log_push                            // add a transfer to the current record
+(
+  DSO_LOG* Log,
+  const unsigned char* Data,                       // CH1 and CH2 pairs, as read
+  int Samples,                                                   // each channel
+  const HT6022_IRTypeDef Range[2]                            // as Data was read
+)
+{
+  LOG_RECORD* r = &Log->Record;
+  const double dt = Log->Header.Interval;
+  double t;
+
+  if(!Log->Data || Samples <= 0) return;
+  t = now() - Log->Header.Start;
+
+  if(r->Samples && (t >= Log->Next || r->Range[0] != Range[0] ||
+    r->Range[1] != Range[1])) record_write(Log);
+  if(t >= Log->Next)                            // next boundary, over any pause
+    Log->Next = dt * ((long long)(t / dt) + 1);
+
+  if(!r->Samples)                                             // start a new one
+  {
+    memset(r, 0, sizeof(*r));
+    r->t = t;
+    r->Range[0] = Range[0], r->Range[1] = Range[1];
+    r->Min[0] = r->Min[1] = 255;
+    Log->Sum[0] = Log->Sum[1] = 0;
+  }
+  reduce(Data, Samples, r->Min, r->Max, Log->Sum);
+  r->Samples += Samples;
+}
+
+
+void log_close(DSO_LOG* Log)                  // write what there is, and finish
+{
+  if(!Log->Data) return;
+  record_write(Log);
+  block_write(Log);
+  fclose(Log->Data);
+  if(Log->Index) fclose(Log->Index);
+  Log->Data = NULL;
+  Log->Index = NULL;
+}
+
+
+static void scan                        // records First to End - 1 into Summary
+(
+  FILE* f,
+  const LOG_HEADER* Header,
+  uint32_t First,
+  uint32_t End,                                // UINT32_MAX: to the end of file
+  LOG_SUMMARY* s,
+  double From,
+  double To
+)
+{
+  static LOG_RECORD r[LOG_BLOCK];
+  double Sum[2] = {0, 0};
+  uint32_t n;
+  uint32_t i;
+
+  if(fseek(f, sizeof(*Header) + (long)First * sizeof(LOG_RECORD), SEEK_SET))
+    return;
+  while(First < End && (n = fread(r, sizeof(LOG_RECORD), LOG_BLOCK, f)) > 0)
+  {
+    if(n > End - First) n = End - First;
+    for(i = 0; i < n; i++)
+    {
+      if(r[i].t < From || r[i].t > To) continue;
+      if(!s->Records || r[i].t < s->From) s->From = r[i].t;
+      if(!s->Records || r[i].t > s->To) s->To = r[i].t;
+      merge(Header, &r[i], s->Min, s->Max, Sum);
+      s->Samples += r[i].Samples;
+      s->Records++;
+    }
+    First += n;
+  }
+  s->Mean[0] += Sum[0];                              // weighted sums, until ...
+  s->Mean[1] += Sum[1];
+}
+
+
+int log_query                         // statistics over From to To, 0 if no log
+(
+  const char* path,
+  double From,                                      // seconds from start of log
+  double To,
+  LOG_SUMMARY* s
+)
+{
+  char index[4096];
+  LOG_HEADER Header;
+  LOG_INDEX b;
+  FILE* f;
+  FILE* x;
+  uint32_t next = 0;                             // first record not in an index
+  int ch;
+
+  memset(s, 0, sizeof(*s));
+  s->Min[0] = s->Min[1] = FLT_MAX;
+  s->Max[0] = s->Max[1] = -FLT_MAX;
+  if(strlen(path) + 5 > sizeof(index)) return 0;
+  strcpy(index, path);
+  strcat(index, ".idx");
+  if((f = fopen(path, "rb")) == NULL) return 0;
+  if
+  (
+    fread(&Header, sizeof(Header), 1, f) != 1 ||
+    memcmp(Header.Magic, Magic, sizeof(Magic)) ||
+    Header.Version != LOG_VERSION || Header.RecordSize != sizeof(LOG_RECORD)
+  )
+  {
+    fclose(f);
+    return 0;
+  }
+
+  if((x = fopen(index, "rb")) != NULL)
+  {
+    while(fread(&b, sizeof(b), 1, x) == 1)
+    {
+      next = b.First + b.Records;
+      if(b.End < From || b.t > To) continue;                     // out of range
+      if(b.t < From || b.End > To)                        // partly: its records
+      {
+        scan(f, &Header, b.First, next, s, From, To);
+        continue;
+      }
+      for(ch = 0; ch < 2; ch++)                           // wholly: the summary
+      {
+        if(b.Min[ch] < s->Min[ch]) s->Min[ch] = b.Min[ch];
+        if(b.Max[ch] > s->Max[ch]) s->Max[ch] = b.Max[ch];
+        s->Mean[ch] += (double)b.Mean[ch] * b.Samples;
+      }
+      if(!s->Records || b.t < s->From) s->From = b.t;
+      if(!s->Records || b.End > s->To) s->To = b.End;
+      s->Samples += b.Samples;
+      s->Records += b.Records;
+    }
+    fclose(x);
+  }
+  scan(f, &Header, next, UINT32_MAX, s, From, To);       // since the last block
+  fclose(f);
+
+  if(s->Samples)                                     // ... divided through here
+    for(ch = 0; ch < 2; ch++) s->Mean[ch] /= s->Samples;
+  return 1;
+}
+
+#ifdef __cplusplus
+    }
+#endif
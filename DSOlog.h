@@ -0,0 +1,128 @@
+/*
+  DSOlog.h: long term data logger for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOLOG_H
+#define DSOLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "HT6022.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define LOG_VERSION 1
+#define LOG_RANGES 4                                // HT6022_10V, 5V, 2V and 1V
+#define LOG_BLOCK 256                        // records summarised by each index
+
+
+typedef struct                               // at the start of the records file
+{
+  char Magic[8];                                                     // "DSOLOG"
+  uint32_t Version;
+  uint32_t RecordSize;                                     // sizeof(LOG_RECORD)
+  double Start;                                 // Unix time of the first record
+  double Interval;                                // seconds, nominal per record
+  double Ts;                                                  // sample interval
+  uint8_t Range[LOG_RANGES];                          // HT6022_IRTypeDef of ...
+  float Volts[2][LOG_RANGES];                      // ... volts per code and ...
+  float Zero[2][LOG_RANGES];                            // ... code for 0V, each
+} LOG_HEADER;
+
+typedef struct                                // one interval, codes as from USB
+{
+  double t;                                       // seconds from Start to first
+  float Mean[2];                                                  // CH1 and CH2
+  uint32_t Samples;                                              // each channel
+  uint8_t Min[2];
+  uint8_t Max[2];
+  uint8_t Range[2];                                  // HT6022_IRTypeDef of each
+  uint8_t Spare[6];
+} LOG_RECORD;
+
+typedef struct                  // every LOG_BLOCK records, in a file of its own
+{
+  double t;                                  // of the first record in the block
+  uint32_t First;                                           // its record number
+  uint32_t Records;                                    // LOG_BLOCK but the last
+  double Samples;
+  float Min[2];                                    // volts, whatever the ranges
+  float Max[2];
+  float Mean[2];
+  double End;                                            // t of its last record
+} LOG_INDEX;
+
+typedef struct                                               // from log_query()
+{
+  double From;                                     // first record in range, and
+  double To;                                                    // last: seconds
+  uint32_t Records;
+  double Samples;
+  float Min[2];                                                         // volts
+  float Max[2];
+  double Mean[2];
+} LOG_SUMMARY;
+
+typedef struct DSO_LOG
+{
+  FILE* Data;                                          // NULL while not logging
+  FILE* Index;
+  LOG_HEADER Header;
+  LOG_RECORD Record;                                        // being accumulated
+  uint64_t Sum[2];                                               // codes so far
+  double Next;                               // seconds: Record ends, from Start
+  uint32_t Records;                                            // written so far
+  LOG_INDEX Block;                                          // being accumulated
+  double BlockSum[2];                              // volts times samples so far
+} DSO_LOG;
+
+
+extern int log_open
+(
+  DSO_LOG* Log,
+  const char* path,
+  double Interval,
+  double Ts,
+  const HT6022_IRTypeDef Range[LOG_RANGES],
+  const float Volts[2][LOG_RANGES],
+  const float Zero[2][LOG_RANGES]
+);
+extern void log_push
+(
+  DSO_LOG* Log,
+  const unsigned char* Data,
+  int Samples,
+  const HT6022_IRTypeDef Range[2]
+);
+extern void log_close(DSO_LOG* Log);
+extern int log_query
+(
+  const char* path,
+  double From,
+  double To,
+  LOG_SUMMARY* Summary
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOLOG_H
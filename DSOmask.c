@@ -0,0 +1,424 @@
+/*
+  DSOmask.c: pass/fail testing of raw acquisitions against a mask of
+  forbidden regions drawn in screen divisions.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  A mask is either a set of polygons read from a text file or an allowed
+  band either side of a reference trace.  Whenever the timebase, range or
+  position changes it is rasterised into a 256 bit map of forbidden ADC
+  codes for each display point on screen, so testing never converts to
+  volts.  The acquisition thread reduces each display interval of raw
+  samples to its minimum and maximum code, which is what the drawn trace
+  covers, and fails if any code in that span is forbidden.
+
+  The map is rasterised by the GUI into whichever of two buffers is not
+  published, then published by swapping one pointer.  The worker names
+  the one it is testing in Testing, much as a hazard pointer, and the GUI
+  waits for it to finish with the spare before drawing there again, so
+  neither reads a map half drawn.  A failed acquisition is handed back
+  to the GUI to be saved with mask_save(): writing it would hold up the
+  USB reads.
+
+  Mask files hold one "polygon" line ahead of each region's vertices, given
+  as time and voltage pairs in divisions; '#' starts a comment.  A region
+  of fewer than three vertices, or one beyond MASK_POLYGONS, is an error
+  at its "polygon" line, and a file in error leaves no mask at all.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include "DSOutils.h"
+#include "DSOmask.h"
+#include "DSOscale.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+DSO_MASK Mask = {.Channel = 0};
+
+
+static double code2div(DSO_CHANNEL* Channel, int code)        // to screen units
+{
+  return 4 * Channel->Scale->Screen[code];                     // as it is drawn
+}
+
+
+static double div2code(DSO_CHANNEL* Channel, double v)
+{
+  const DSO_SCALE* s = Channel->Scale;
+
+  return (v / 4 - s->ScreenZero) / s->ScreenStep;
+}
+
+
+static void forbid                      // set bits for a span in divisions
+(
+  uint8_t* lut,
+  DSO_CHANNEL* Channel,
+  double v0,
+  double v1
+)
+{
+  double c0 = div2code(Channel, v0);
+  double c1 = div2code(Channel, v1);
+  double t;
+  int c;
+
+  if(c0 > c1) t = c0, c0 = c1, c1 = t;              // inverted channel
+  c0 = ceil(c0 - 0.5);                       // codes whose centre is inside
+  c1 = floor(c1 + 0.5);
+  if(c0 < 0) c0 = 0;
+  if(c1 > 255) c1 = 255;
+  for(c = (int)c0; c <= (int)c1; c++) lut[c >> 3] |= 1 << (c & 7);
+}
+
+
+static int crossings             // vertical line through polygon, sorted
+(
+  MASK_POLYGON* P,
+  double t,
+  double* v
+)
+{
+  double a;
+  double b;
+  int n = 0;
+  int i;
+  int k;
+
+  for(i = 0; i < P->Count; i++)
+  {
+    k = (i + 1) % P->Count;
+    a = P->t[i], b = P->t[k];
+    if((a <= t && t < b) || (b <= t && t < a))          // half open: no doubles
+      v[n++] = P->v[i] + (t - a) * (P->v[k] - P->v[i]) / (b - a);
+  }
+  for(i = 1; i < n; i++)                               // insertion sort, tiny n
+    for(k = i; k && v[k-1] > v[k]; k--) a = v[k], v[k] = v[k-1], v[k-1] = a;
+  return n;
+}
+
+
+int mask_load(DSO_MASK* Mask, const char* path)  // 0 or line number in error
+{
+  FILE* file;
+  MASK_POLYGON* P = NULL;
+  char line[256];
+  char* s;
+  char* e;
+  double t;
+  double v;
+  int n = 0;
+  int at = 0;                                   // line of P's "polygon" heading
+  int bad = 0;                                          // line in error, if any
+
+  file = fopen(path, "rt");
+  if(!file) return -1;
+
+  mask_withdraw(Mask);
+  Mask->Polygons = 0;
+  while(!bad && fgets(line, sizeof(line), file))
+  {
+    n++;
+    if((s = strchr(line, '#'))) *s = 0;
+    for(s = line; *s == ' ' || *s == '\t'; s++);
+    if(!strncmp(s, "polygon", 7))
+    {
+      if(P && P->Count < 3) bad = at;                  // too few to enclose any
+      else if(Mask->Polygons == MASK_POLYGONS) bad = n;
+      else
+      {
+        P = &Mask->Polygon[Mask->Polygons++];
+        P->Count = 0;
+        at = n;
+      }
+      continue;
+    }
+    for(;;)                                     // "t, v" pairs in divisions
+    {
+      t = strtod(s, &e);
+      if(e == s) break;
+      for(s = e; *s == ',' || *s == ' ' || *s == '\t'; s++);
+      v = strtod(s, &e);
+      if(e == s || !P || P->Count == MASK_VERTICES)
+      {
+        bad = n;
+        break;
+      }
+      for(s = e; *s == ',' || *s == ' ' || *s == '\t'; s++);
+      P->t[P->Count] = t, P->v[P->Count] = v, P->Count++;
+    }
+  }
+  if(!bad && P && P->Count < 3) bad = at;                     // the last region
+  fclose(file);
+  if(bad)
+  {
+    Mask->Polygons = 0;
+    return bad;
+  }
+
+  Mask->Auto = false;
+  Mask->Enabled = Mask->Polygons > 0;
+  mask_clear_counts(Mask);
+  return 0;
+}
+
+
+void mask_from_trace               // allowed band around the displayed trace
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                              // timing of the frame in CH0
+  int TriggerPoint,
+  DSO_CHANNEL* Channel,                             // channel to take it from
+  int channel,                                                     // 0 or 1
+  double dt,                                 // horizontal tolerance, divisions
+  double dv                                    // vertical tolerance, divisions
+)
+{
+  static double lo[MASK_BAND];
+  static double hi[MASK_BAND];
+  double dtd = Set->Ts * Set->SubSample / Set->Tdiv;     // divisions per column
+  unsigned char* ch;
+  double a;
+  double b;
+  double t;
+  int first = TriggerPoint + Set->TriggerDelay;
+  int w = (int)(dt * 100 + 0.5);                       // band index tolerance
+  int i;
+  int j;
+  int k;
+  int c;
+  int min;
+  int max;
+
+  mask_withdraw(Mask);
+  for(k = 0; k < MASK_BAND; k++) lo[k] = 4, hi[k] = -4;
+
+  for(j = 0; first + (j + 1) * Set->SubSample <= Set->MemDepth; j++)
+  {
+    k = (int)(j * dtd * 100 + 0.5);
+    if(k >= MASK_BAND) break;
+    ch = CH0 + 2 * (first + j * Set->SubSample) + channel;
+    for(i = 0, min = 255, max = 0; i < Set->SubSample; i++)
+    {
+      c = ch[2 * i];
+      if(c < min) min = c;
+      if(c > max) max = c;
+    }
+    a = code2div(Channel, min), b = code2div(Channel, max);
+    if(a > b) t = a, a = b, b = t;                          // inverted channel
+    for(i = k; i < MASK_BAND && i <= k + (int)(dtd * 100); i++)
+    {                                // columns may be more than 0.01 div apart
+      if(a < lo[i]) lo[i] = a;
+      if(b > hi[i]) hi[i] = b;
+    }
+  }
+
+  for(k = 0; k < MASK_BAND; k++)                // widen by both tolerances
+  {
+    Mask->Lo[k] = 4, Mask->Hi[k] = -4;
+    for(i = k - w < 0 ? 0 : k - w; i <= k + w && i < MASK_BAND; i++)
+    {
+      if(lo[i] < Mask->Lo[k]) Mask->Lo[k] = lo[i];
+      if(hi[i] > Mask->Hi[k]) Mask->Hi[k] = hi[i];
+    }
+    Mask->Lo[k] -= dv;
+    Mask->Hi[k] += dv;
+  }
+
+  Mask->Auto = true;
+  Mask->Channel = channel;
+  Mask->Enabled = true;
+  mask_clear_counts(Mask);
+}
+
+
+static int mask_columns(const DSO_SET* Set)          // display points on screen
+{
+  int n = (int)(10 / (Set->Ts * Set->SubSample / Set->Tdiv)) + 1;
+
+  return n > MASK_COLUMNS ? MASK_COLUMNS : n;
+}
+
+
+void mask_rasterise(DSO_MASK* Mask, DSO_CHANNEL* Channel)  // after any change
+{
+  double dtd = Dso.Ts * Dso.SubSample / Dso.Tdiv;     // divisions per column
+  double v[2 * MASK_VERTICES];
+  double t;
+  MASK_LUT* L;
+  int p;
+  int n;
+  int i;
+  int j;
+  int k;
+                                       // the one not published, once let go
+  L = __atomic_load_n(&Mask->Lut, __ATOMIC_ACQUIRE) == &Mask->Luts[0] ?
+    &Mask->Luts[1] : &Mask->Luts[0];
+  while(__atomic_load_n(&Mask->Testing, __ATOMIC_SEQ_CST) == L) sched_yield();
+
+  memset(L->Bits, 0, sizeof(L->Bits));
+  L->Channel = Mask->Channel;
+  L->Columns = mask_columns(&Dso);
+
+  for(j = 0; j < L->Columns; j++)
+  {
+    t = j * dtd;
+    if(Mask->Auto)
+    {
+      k = (int)(t * 100 + 0.5);
+      if(k >= MASK_BAND) k = MASK_BAND - 1;
+      if(Mask->Hi[k] < Mask->Lo[k]) continue;              // no reference here
+      forbid(L->Bits[j], Channel, -1e6, Mask->Lo[k] - 1e-9);
+      forbid(L->Bits[j], Channel, Mask->Hi[k] + 1e-9, 1e6);
+      continue;
+    }
+    for(p = 0; p < Mask->Polygons; p++)           // even-odd fill per column
+    {
+      n = crossings(&Mask->Polygon[p], t, v);
+      for(i = 0; i + 1 < n; i += 2) forbid(L->Bits[j], Channel, v[i], v[i+1]);
+    }
+  }
+  __atomic_store_n(&Mask->Lut, Mask->Enabled ? L : NULL, __ATOMIC_SEQ_CST);
+}
+
+
+void mask_withdraw(DSO_MASK* Mask)      // worker tests nothing until rasterised
+{
+  __atomic_store_n(&Mask->Lut, NULL, __ATOMIC_SEQ_CST);
+}
+
+
+void mask_clear_counts(DSO_MASK* Mask)
+{
+  Mask->Passes = 0;
+  Mask->Fails = 0;
+  Mask->Saved = 0;
+  Mask->FirstFail = -1;
+  memset(Mask->FailAt, 0, sizeof(Mask->FailAt));
+}
+
+
+static inline bool forbidden(const uint8_t* lut, int lo, int hi)
+{
+  int c;
+
+  for(c = lo; c <= hi; c++)
+  {
+    if(!(c & 7) && c + 7 <= hi && !lut[c >> 3]) { c += 7; continue; }
+    if(lut[c >> 3] & (1 << (c & 7))) return true;
+  }
+  return false;
+}
+
+
+bool mask_test                   // true on failure, from acquisition thread
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                         // as pinned when CH0 was captured
+  int TriggerPoint
+)
+{
+  const int SubSample = Set->SubSample;
+  const unsigned char* ch;
+  MASK_LUT* L;
+  int first = TriggerPoint + Set->TriggerDelay;
+  int columns;
+  int fail = -1;
+  int i;
+  int j;
+  int min;
+  int max;
+
+  do                           // named before it is read, so it stays unchanged
+  {
+    L = __atomic_load_n(&Mask->Lut, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&Mask->Testing, L, __ATOMIC_SEQ_CST);
+  }
+  while(L != __atomic_load_n(&Mask->Lut, __ATOMIC_SEQ_CST));
+  if(!L) return false;
+
+  columns = L->Columns;
+  if(first + columns * SubSample > Set->MemDepth)
+    columns = (Set->MemDepth - first) / SubSample;
+
+  ch = CH0 + 2 * first + L->Channel;
+  for(j = 0; j < columns; j++, ch += 2 * SubSample)
+  {
+    for(i = 0, min = 255, max = 0; i < SubSample; i++)
+    {
+      min = ch[2 * i] < min ? ch[2 * i] : min;
+      max = ch[2 * i] > max ? ch[2 * i] : max;
+    }
+    if(j + 1 < columns)        // join to the next point, as the trace is drawn
+    {
+      min = ch[2 * SubSample] < min ? ch[2 * SubSample] : min;
+      max = ch[2 * SubSample] > max ? ch[2 * SubSample] : max;
+    }
+    if(forbidden(L->Bits[j], min, max))
+    {
+      if(fail < 0) fail = j;
+      Mask->FailAt[j]++;
+    }
+  }
+  __atomic_store_n(&Mask->Testing, NULL, __ATOMIC_RELEASE);
+
+  if(fail < 0)
+  {
+    Mask->Passes++;
+    return false;
+  }
+
+  Mask->Fails++;
+  Mask->FirstFail = fail;
+  if(Mask->StopOnFail) Mask->Stopped = true;
+  return true;
+}
+
+
+bool mask_save                   // failure as ~/maskfail_NNNN.csv, from the GUI
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                         // as pinned when CH0 was captured
+  int TriggerPoint
+)
+{
+  char name[32];
+  int first = TriggerPoint + Set->TriggerDelay;
+  int n = mask_columns(Set);
+
+  if(Mask->Saved >= MASK_SAVES) return false;
+  if(first + n * Set->SubSample > Set->MemDepth)
+    n = (Set->MemDepth - first) / Set->SubSample;
+  sprintf(name, "/maskfail_%04u.csv", Mask->Saved++);
+  return write_trace(name, CH0, first, n * Set->SubSample, Set->Ts);
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,112 @@
+/*
+  DSOmask.h: mask (limit) testing for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOMASK_H
+#define DSOMASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dso.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define MASK_COLUMNS  HT6022_1KB                 // one per display point
+#define MASK_POLYGONS 8
+#define MASK_VERTICES 32
+#define MASK_BAND     1001          // auto mask limits every 0.01 division
+#define MASK_SAVES    100         // most failing waveforms written to disk
+
+
+typedef struct
+{
+  int Count;
+  double t[MASK_VERTICES];                      // divisions: 0 to 10
+  double v[MASK_VERTICES];                      // divisions: -4 to +4
+} MASK_POLYGON;
+
+typedef struct MASK_LUT              // as rasterised for the worker to test
+{
+  int Channel;                                          // 0 or 1 under test
+  int Columns;                                   // display points on screen
+  uint8_t Bits[MASK_COLUMNS][32];       // bit set: code forbidden in column
+} MASK_LUT;
+
+typedef struct DSO_MASK
+{
+  bool Enabled;
+  bool Auto;                  // limits from a reference trace, not polygons
+  bool StopOnFail;
+  bool SaveOnFail;
+  volatile bool Stopped;                  // worker held on a failure
+  int Channel;                                            // 0 or 1 under test
+  int Polygons;
+  MASK_POLYGON Polygon[MASK_POLYGONS];                 // forbidden regions
+  double Lo[MASK_BAND];                     // auto: allowed band, divisions
+  double Hi[MASK_BAND];
+  MASK_LUT Luts[2];                   // one published, one to rasterise ...
+  MASK_LUT* Lut;              // ... swapped in here, NULL while not testing
+  MASK_LUT* Testing;                    // as the worker reads it, else NULL
+  unsigned int Passes;
+  unsigned int Fails;
+  unsigned int Saved;
+  int FirstFail;                      // column of first failure, last fail
+  unsigned int FailAt[MASK_COLUMNS];             // failures by column
+} DSO_MASK;
+
+
+extern DSO_MASK Mask;
+
+extern int mask_load(DSO_MASK* Mask, const char* path);
+extern void mask_from_trace
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                              // timing of the frame in CH0
+  int TriggerPoint,
+  DSO_CHANNEL* Channel,                             // channel to take it from
+  int channel,                                                     // 0 or 1
+  double dt,                                 // horizontal tolerance, divisions
+  double dv                                    // vertical tolerance, divisions
+);
+extern void mask_rasterise(DSO_MASK* Mask, DSO_CHANNEL* Channel);
+extern void mask_withdraw(DSO_MASK* Mask);
+extern void mask_clear_counts(DSO_MASK* Mask);
+extern bool mask_test
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                         // as pinned when CH0 was captured
+  int TriggerPoint
+);
+extern bool mask_save
+(
+  DSO_MASK* Mask,
+  unsigned char* CH0,                          // interleaved waveforms from USB
+  const DSO_SET* Set,                         // as pinned when CH0 was captured
+  int TriggerPoint
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOMASK_H
@@ -0,0 +1,443 @@
+/*
+  DSOmath.c: compile and evaluate math channel expressions over both inputs.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  An expression such as "abs(A-B)" or "1e3*int(filt(A,20))" is compiled once
+  into a short postfix program.  Each instruction is a kernel applied to a
+  block of MATH_BLOCK samples at a time, so the inner loops are simple enough
+  for the compiler to vectorise.  Evaluation runs at the full sample rate
+  and is then decimated in step with scan() in PostTrig.c.
+
+  Grammar:   expr    := term { ('+'|'-') term }
+             term    := unary { '*' unary }
+             unary   := '-' unary | primary
+             primary := number | 'A' | 'B' | '(' expr ')' |
+                        abs(expr) | int(expr) | diff(expr) |
+                        filt(expr [, samples])
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include "dso.h"
+#include "DSOmath.h"
+#include "DSOscale.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+DSO_MATH Math[MATH_TRACES] =
+{
+  {false, "", 0, {{MATH_A, 0, 0}}, 1.0, 0},
+  {false, "", 0, {{MATH_A, 0, 0}}, 1.0, 0}
+};
+
+static float Stack[MATH_STACK][MATH_BLOCK];         // evaluation stack blocks
+static float A[MATH_BLOCK];                         // de-interleaved channel 1
+static float B[MATH_BLOCK];                         // de-interleaved channel 2
+
+
+typedef struct                                           // compiler state
+{
+  const char* src;
+  int pos;
+  int depth;                                      // current stack occupancy
+  int error;                             // 1 + position of first error, or 0
+  DSO_MATH* Math;
+} MATH_PARSER;
+
+
+static void expr(MATH_PARSER* p);
+
+
+static void skip(MATH_PARSER* p)
+{
+  while(isspace((unsigned char)p->src[p->pos])) p->pos++;
+}
+
+
+static void fail(MATH_PARSER* p)
+{
+  if(!p->error) p->error = p->pos + 1;
+}
+
+
+static void emit(MATH_PARSER* p, MATH_OP_TypeDef Op, float Value)
+{
+  DSO_MATH* m = p->Math;
+  MATH_INSTR* last = m->Length ? &m->Prog[m->Length - 1] : NULL;
+  MATH_INSTR* prev = m->Length > 1 ? &m->Prog[m->Length - 2] : NULL;
+
+  if(p->error) return;
+
+  if(Op == MATH_NEG && last && last->Op == MATH_CONST)
+  {
+    last->Value = -last->Value;
+    return;
+  }
+
+  if(Op == MATH_ADD || Op == MATH_SUB || Op == MATH_MUL)
+  {
+    if(prev && last->Op == MATH_CONST && prev->Op == MATH_CONST)
+    {                                              // fold constant expression
+      if(Op == MATH_ADD) prev->Value += last->Value;
+      else if(Op == MATH_SUB) prev->Value -= last->Value;
+      else prev->Value *= last->Value;
+      m->Length--, p->depth--;
+      return;
+    }
+    if(last && last->Op == MATH_CONST)          // x op k: fuse into one kernel
+    {
+      if(Op == MATH_MUL) last->Op = MATH_SCALE;
+      else last->Op = MATH_OFFSET;
+      if(Op == MATH_SUB) last->Value = -last->Value;
+      p->depth--;
+      return;
+    }
+    if(prev && prev->Op == MATH_CONST && Op != MATH_SUB &&
+      (last->Op == MATH_A || last->Op == MATH_B))   // k op A: swap, then fuse
+    {
+      prev->Op = last->Op;
+      last->Op = Op == MATH_MUL ? MATH_SCALE : MATH_OFFSET;
+      last->Value = prev->Value;
+      prev->Value = 0;
+      p->depth--;
+      return;
+    }
+  }
+
+  if(m->Length >= MATH_PROG)
+  {
+    fail(p);
+    return;
+  }
+
+  m->Prog[m->Length].Op = Op;
+  m->Prog[m->Length].Value = Value;
+  m->Prog[m->Length].State = 0;
+  m->Length++;
+
+  if(Op == MATH_A || Op == MATH_B || Op == MATH_CONST)
+  {
+    if(++p->depth > MATH_STACK) fail(p);
+  }
+  else if(Op == MATH_ADD || Op == MATH_SUB || Op == MATH_MUL) p->depth--;
+}
+
+
+static void primary(MATH_PARSER* p)
+{
+  static const struct { const char* name; MATH_OP_TypeDef Op; } func[4] =
+  {
+    {"abs", MATH_ABS}, {"int", MATH_INT},
+    {"diff", MATH_DIFF}, {"filt", MATH_FILT}
+  };
+
+  const char* s;
+  char* end;
+  double value;
+  double samples;
+  int i;
+  int n;
+
+  skip(p);
+  s = p->src + p->pos;
+
+  if(*s == '(')
+  {
+    p->pos++;
+    expr(p);
+    skip(p);
+    if(p->src[p->pos] != ')') fail(p);
+    else p->pos++;
+    return;
+  }
+
+  if(strchr("AaBb", *s) && *s && !isalpha((unsigned char)s[1]))
+  {
+    emit(p, toupper((unsigned char)*s) == 'A' ? MATH_A : MATH_B, 0);
+    p->pos++;
+    return;
+  }
+
+  if(isdigit((unsigned char)*s) || *s == '.')
+  {
+    value = strtod(s, &end);
+    p->pos += end - s;
+    emit(p, MATH_CONST, (float)value);
+    return;
+  }
+
+  for(i = 0; i < 4; i++)
+  {
+    n = strlen(func[i].name);
+    if(strncmp(s, func[i].name, n) == 0 && s[n] == '(')
+    {
+      p->pos += n + 1;
+      expr(p);
+      skip(p);
+      samples = 10;                           // default filter time constant
+      if(func[i].Op == MATH_FILT && p->src[p->pos] == ',')
+      {
+        s = p->src + ++p->pos;
+        samples = strtod(s, &end);
+        p->pos += end - s;
+        if(end == s || samples < 1) fail(p);
+        skip(p);
+      }
+      if(p->src[p->pos] != ')') fail(p);
+      else p->pos++;
+      emit(p, func[i].Op, func[i].Op == MATH_FILT ? (float)(1/samples) : 0);
+      return;
+    }
+  }
+  fail(p);
+}
+
+
+static void unary(MATH_PARSER* p)
+{
+  skip(p);
+  if(p->src[p->pos] == '-')
+  {
+    p->pos++;
+    unary(p);
+    emit(p, MATH_NEG, 0);
+  }
+  else primary(p);
+}
+
+
+static void term(MATH_PARSER* p)
+{
+  unary(p);
+  for(skip(p); p->src[p->pos] == '*' && !p->error; skip(p))
+  {
+    p->pos++;
+    unary(p);
+    emit(p, MATH_MUL, 0);
+  }
+}
+
+
+static void expr(MATH_PARSER* p)
+{
+  char c;
+
+  term(p);
+  for(skip(p); !p->error; skip(p))
+  {
+    c = p->src[p->pos];
+    if(c != '+' && c != '-') break;
+    p->pos++;
+    term(p);
+    emit(p, c == '+' ? MATH_ADD : MATH_SUB, 0);
+  }
+}
+
+
+int math_compile(DSO_MATH* Math, const char* Expr)     // 0 or error position
+{
+  DSO_MATH m = *Math;                         // Math is left as it was on error
+  MATH_PARSER p = {Expr, 0, 0, 0, &m};
+
+  m.Enabled = false;
+  m.Length = 0;
+  strncpy(m.Expr, Expr, MATH_EXPR - 1);
+  m.Expr[MATH_EXPR - 1] = 0;
+
+  skip(&p);
+  if(Expr[p.pos] != 0)                                  // else empty: trace off
+  {
+    expr(&p);
+    skip(&p);
+    if(Expr[p.pos] != 0) fail(&p);
+    if(p.error) return p.error;
+    m.Enabled = true;
+  }
+  *Math = m;
+  return 0;
+}
+
+
+static void reset(DSO_MATH* Math)         // clear kernel state for new trace
+{
+  int i;
+
+  for(i = 0; i < Math->Length; i++)
+    Math->Prog[i].State = Math->Prog[i].Op == MATH_INT ? 0 : NAN;
+}
+
+
+static float* execute                  // run compiled program over one block
+(
+  DSO_MATH* Math,
+  int n,                                              // samples in this block
+  float Ts                                           // sample interval, secs
+)
+{
+  MATH_INSTR* p;
+  float* x;
+  float* y;
+  float v;
+  float s;
+  int sp = 0;
+  int i;
+  int k;
+
+  for(i = 0; i < Math->Length; i++)
+  {
+    p = &Math->Prog[i];
+    x = Stack[sp > 0 ? sp - 1 : 0];                          // top of stack
+    switch(p->Op)
+    {
+      case MATH_A:
+        x = Stack[sp++];
+        memcpy(x, A, n * sizeof(float));
+        break;
+      case MATH_B:
+        x = Stack[sp++];
+        memcpy(x, B, n * sizeof(float));
+        break;
+      case MATH_CONST:
+        x = Stack[sp++];
+        for(k = 0; k < n; k++) x[k] = p->Value;
+        break;
+      case MATH_ADD:
+        y = Stack[--sp], x = Stack[sp - 1];
+        for(k = 0; k < n; k++) x[k] += y[k];
+        break;
+      case MATH_SUB:
+        y = Stack[--sp], x = Stack[sp - 1];
+        for(k = 0; k < n; k++) x[k] -= y[k];
+        break;
+      case MATH_MUL:
+        y = Stack[--sp], x = Stack[sp - 1];
+        for(k = 0; k < n; k++) x[k] *= y[k];
+        break;
+      case MATH_NEG:
+        for(k = 0; k < n; k++) x[k] = -x[k];
+        break;
+      case MATH_ABS:
+        for(k = 0; k < n; k++) x[k] = fabsf(x[k]);
+        break;
+      case MATH_SCALE:
+        for(k = 0; k < n; k++) x[k] *= p->Value;
+        break;
+      case MATH_OFFSET:
+        for(k = 0; k < n; k++) x[k] += p->Value;
+        break;
+      case MATH_INT:                  // running sums carry across block edges
+        for(k = 0, s = p->State; k < n; k++) s += x[k] * Ts, x[k] = s;
+        p->State = s;
+        break;
+      case MATH_DIFF:
+        s = isnan(p->State) ? x[0] : p->State;
+        for(k = 0; k < n; k++) v = x[k], x[k] = (v - s) / Ts, s = v;
+        p->State = s;
+        break;
+      case MATH_FILT:
+        s = isnan(p->State) ? x[0] : p->State;
+        for(k = 0; k < n; k++) s += p->Value * (x[k] - s), x[k] = s;
+        p->State = s;
+        break;
+    }
+  }
+  return Stack[0];
+}
+
+
+int math_scan              // evaluate all enabled math traces over display data
+(
+  float* M[MATH_TRACES],                       // output traces in volts
+  const FRAME_CHANNEL* SrcA,                         // channel 1, read in place
+  const FRAME_CHANNEL* SrcB,                                        // channel 2
+  int triggerIdx,                               // initial trigger edge position
+  DSO_MATH* Math,                                // array of MATH_TRACES entries
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2,
+  const DSO_SET* Set,                                     // timing of the frame
+  int SzDispBuf                                            // Display bufer size
+)
+{
+  const float* lut1 = Channel1->Scale->Volts;      // code to volts, per channel
+  const float* lut2 = Channel2->Scale->Volts;
+  const unsigned char* a;
+  const unsigned char* b;
+  float* r;
+  int SubSample = Set->SubSample;
+  int offset = 0;
+  int first;                                     // first sample to evaluate
+  int count;                                       // samples to evaluate
+  int next;                          // sample index of next display point
+  int i;
+  int j = 0;
+  int j0;
+  int k;
+  int n;
+  int t;
+
+  if(!Math[0].Enabled && !Math[1].Enabled) return 0;
+
+  if(triggerIdx < 8)                       // same indexing as scan(): see there
+  {
+    offset = 8+5 - triggerIdx;
+    triggerIdx = 8+5;
+  }
+  j0 = offset / SubSample;
+  if(j0 >= SzDispBuf) return 0;
+  if(SrcA->Length - triggerIdx < SzDispBuf * SubSample)
+    SzDispBuf = (SrcA->Length - triggerIdx) / SubSample;
+
+  for(t = 0; t < MATH_TRACES; t++) reset(&Math[t]);
+
+  first = triggerIdx - 8;
+  count = (SzDispBuf - j0) * SubSample;
+
+  for(i = 0, next = 0; i < count; i += n)
+  {
+    n = count - i < MATH_BLOCK ? count - i : MATH_BLOCK;
+    a = SrcA->Data + SrcA->Stride * (first + i);
+    b = SrcB->Data + SrcB->Stride * (first + i);
+    for(k = 0; k < n; k++)                                    // de-interleave
+    {
+      A[k] = lut1[a[SrcA->Stride * k]];
+      B[k] = lut2[b[SrcB->Stride * k]];
+    }
+
+    for(t = 0; t < MATH_TRACES; t++)
+    {
+      if(!Math[t].Enabled) continue;
+      r = execute(&Math[t], n, (float)Set->Ts);
+      for(k = next - i, j = j0 + next / SubSample; k < n; k += SubSample, j++)
+        M[t][j] = r[k];                                           // decimate
+    }
+    while(next < i + n) next += SubSample;
+  }
+  return j;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,94 @@
+/*
+  DSOmath.h: math channel expressions for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOMATH_H
+#define DSOMATH_H
+
+#include <stdbool.h>
+#include "dso.h"
+#include "DSOframe.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define MATH_TRACES 2                          // concurrent math trace displays
+#define MATH_PROG   32                       // maximum compiled program length
+#define MATH_STACK  4                         // evaluation stack depth (blocks)
+#define MATH_BLOCK  1024                      // samples per kernel invocation
+#define MATH_EXPR   64                          // maximum source string length
+
+
+typedef enum
+{
+  MATH_A,                                          // push channel 1 in volts
+  MATH_B,                                          // push channel 2 in volts
+  MATH_CONST,                                            // push constant Value
+  MATH_ADD,
+  MATH_SUB,
+  MATH_MUL,
+  MATH_NEG,
+  MATH_ABS,
+  MATH_INT,                                  // running integral, volt seconds
+  MATH_DIFF,                                     // derivative, volts/second
+  MATH_FILT,                    // single pole low pass, Value is coefficient
+  MATH_SCALE,                                  // fused multiply by constant
+  MATH_OFFSET                                       // fused add of constant
+} MATH_OP_TypeDef;
+
+typedef struct
+{
+  MATH_OP_TypeDef Op;
+  float Value;                           // constant or filter coefficient
+  float State;             // integrator, differentiator or filter memory
+} MATH_INSTR;
+
+typedef struct DSO_MATH
+{
+  bool Enabled;
+  char Expr[MATH_EXPR];                       // source, as entered by user
+  int Length;                                  // number of instructions
+  MATH_INSTR Prog[MATH_PROG];                      // compiled kernel chain
+  double Vdiv;                                         // display sensitivity
+  double VOffset;                          // display position: -1.0 to 1.0
+} DSO_MATH;
+
+
+extern DSO_MATH Math[MATH_TRACES];
+
+extern int math_compile(DSO_MATH* Math, const char* Expr);
+extern int math_scan
+(
+  float* M[MATH_TRACES],                       // output traces in volts
+  const FRAME_CHANNEL* SrcA,                         // channel 1, read in place
+  const FRAME_CHANNEL* SrcB,                                        // channel 2
+  int triggerIdx,                               // initial trigger edge position
+  DSO_MATH* Math,
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2,
+  const DSO_SET* Set,                                     // timing of the frame
+  int SzDispBuf                                           // Display bufer size
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOMATH_H
@@ -0,0 +1,130 @@
+/*
+  DSOraster.c: trace rasteriser for the 6022 'scope display, drawing
+  straight into the display image rather than through QPainter.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  A trace is at most one point per display interval, so at any timebase
+  it is drawn as one vertical run of pixels per column: from the lowest
+  to the highest the line reaches within that column.  Each segment of the
+  line updates the runs of the columns it crosses, interpolated at column
+  edges, then every run is written as plain 32 bit stores.  There is no
+  antialiasing, stroking or path building, just as on a CRT the trace is
+  continuous however steep.  Dots mode writes only the points themselves.
+*/
+
+
+#include "DSOraster.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static int16_t Lo[RASTER_WIDTH];           // run for each column, GUI thread only
+static int16_t Hi[RASTER_WIDTH];
+
+
+static inline int row(float y)                   // nearest, -1 if above the top
+{
+  if(!(y >= -1)) return -1;           // clamped before conversion, NaN included
+  if(y > INT16_MAX - 2) return INT16_MAX - 2;
+  return (int)(y + 1.5f) - 1;                   // truncation as floor, not libm
+}
+
+
+static inline void reach(int c, float a, float b)       // column c spans a to b
+{
+  int lo = row(a < b ? a : b);
+  int hi = row(a < b ? b : a);
+
+  if(lo < Lo[c]) Lo[c] = lo;
+  if(hi > Hi[c]) Hi[c] = hi;
+}
+
+
+void raster_trace                  // draw one trace over the image, no blending
+(
+  const RASTER_IMAGE* Image,
+  const float* X,                              // pixel positions, in time order
+  const float* Y,
+  int n,
+  uint32_t Colour,                                                 // 0xAARRGGBB
+  unsigned char Pattern,                       // RASTER_SOLID, RASTER_DASH etc.
+  bool Dots                                     // points only, no joining lines
+)
+{
+  const int w = Image->Width < RASTER_WIDTH ? Image->Width : RASTER_WIDTH;
+  const int h = Image->Height;
+  float x0, x1, y0, y1;
+  float slope;
+  float xa, xb;
+  int c0, c1;
+  int c;
+  int r;
+  int k;
+
+  if(Dots)
+  {
+    for(k = 0; k < n; k++)
+    {
+      if(!(X[k] >= 0 && X[k] < w)) continue;
+      c = (int)X[k];
+      r = row(Y[k]);
+      if(r >= 0 && r < h && (Pattern >> (c & 7) & 1))
+        Image->Bits[r * Image->Stride + c] = Colour;
+    }
+    return;
+  }
+
+  for(c = 0; c < w; c++) Lo[c] = INT16_MAX, Hi[c] = INT16_MIN;     // no run yet
+
+  for(k = 1; k < n; k++)
+  {
+    x0 = X[k-1], y0 = Y[k-1];
+    x1 = X[k], y1 = Y[k];
+    if(!(x1 >= 0 && x0 < w)) continue;                        // off either side
+    c0 = x0 < 0 ? 0 : (int)x0;
+    c1 = x1 >= w ? w - 1 : (int)x1;
+    if(c0 >= c1 || x1 - x0 < 1e-3f)                     // within the one column
+    {
+      reach(c0, y0, y1);
+      if(c1 != c0) reach(c1, y0, y1);
+      continue;
+    }
+    slope = (y1 - y0) / (x1 - x0);
+    for(c = c0; c <= c1; c++)               // where the line is at column edges
+    {
+      xa = c > x0 ? c : x0;
+      xb = c + 1 < x1 ? c + 1 : x1;
+      reach(c, y0 + slope * (xa - x0), y0 + slope * (xb - x0));
+    }
+  }
+
+  for(c = 0; c < w; c++)
+  {
+    if(Lo[c] > Hi[c] || !(Pattern >> (c & 7) & 1)) continue;
+    r = Lo[c] < 0 ? 0 : Lo[c];
+    k = Hi[c] >= h ? h - 1 : Hi[c];
+    for(; r <= k; r++) Image->Bits[r * Image->Stride + c] = Colour;
+  }
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,63 @@
+/*
+  DSOraster.h: trace rasteriser for the 6022 'scope display.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSORASTER_H
+#define DSORASTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define RASTER_WIDTH 4096                      // widest plot area drawn, pixels
+
+#define RASTER_SOLID 0xFF                // Pattern: columns drawn of each eight
+#define RASTER_DASH 0x0F
+#define RASTER_DOT 0x55
+#define RASTER_DASHDOT 0x2F
+
+
+typedef struct
+{
+  uint32_t* Bits;                         // top left pixel of the area drawn on
+  int Stride;                                 // pixels from one row to the next
+  int Width;
+  int Height;
+} RASTER_IMAGE;
+
+
+extern void raster_trace
+(
+  const RASTER_IMAGE* Image,
+  const float* X,                              // pixel positions, in time order
+  const float* Y,
+  int n,
+  uint32_t Colour,                                                 // 0xAARRGGBB
+  unsigned char Pattern,
+  bool Dots
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSORASTER_H
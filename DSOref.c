@@ -0,0 +1,342 @@
+/*
+  DSOref.c: reference waveforms kept in memory mapped files, with min and
+  max pyramids so any timebase is drawn from a thousand or so values.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  A reference is the whole capture behind the traces on screen, both
+  channels de-interleaved, followed for each channel by the minimum and
+  maximum of every block of 2, 4, 8 ... samples up to the whole record;
+  about three times the codes, 6MB for a 1MB capture.  Loading one is an
+  mmap() and a check of the header, so takes no time whatever its size;
+  pages are read as drawing touches them, and a slow timebase only ever
+  touches the small pyramid levels.
+
+  ref_trace() formats a channel for the timebase and delay now set: the
+  samples themselves where a screen holds fewer than 1K, else a min and
+  max pair per column from the pyramid level with blocks just under a
+  column wide, as roll mode shows them.  That is done only when timebase,
+  delay or vertical settings change, never per frame.  The volts per code
+  of the capture are kept so the trace stays in volts when the range is
+  changed; it is drawn as captured, whatever the channel's inversion.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DSOref.h"
+#include "DSOutils.h"
+#include "DSOscale.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static const char Magic[8] = "DSOREF";
+static uint8_t Work[2][HT6022_1MB];           // one level and the next, in turn
+
+
+int ref_dir(char* path, int n)                 // ~/.scope_refs, made if need be
+{
+  int m = get_home_path(path, REF_DIR, n);
+
+  if(m) mkdir(path, 0755);                               // fails if it is there
+  return m;
+}
+
+
+int ref_slot(char* path, int n, int slot)         // link to the file REFn shows
+{
+  char dir[128];
+  int m;
+
+  if(!ref_dir(dir, sizeof(dir))) return 0;
+  m = snprintf(path, n, "%s/.REF%d", dir, slot + 1);
+  return m < n ? m : 0;
+}
+
+
+static int pyramid                          // pairs of level from that below it
+(
+  uint8_t* Pairs,
+  const uint8_t* Below,
+  int Blocks,                                              // of the level built
+  bool Samples                             // Below is codes, not min, max pairs
+)
+{
+  uint8_t lo;
+  uint8_t hi;
+  int i;
+
+  for(i = 0; i < Blocks; i++)
+  {
+    if(Samples)
+    {
+      lo = Below[2*i] < Below[2*i+1] ? Below[2*i] : Below[2*i+1];
+      hi = Below[2*i] > Below[2*i+1] ? Below[2*i] : Below[2*i+1];
+    }
+    else
+    {
+      lo = Below[4*i] < Below[4*i+2] ? Below[4*i] : Below[4*i+2];
+      hi = Below[4*i+1] > Below[4*i+3] ? Below[4*i+1] : Below[4*i+3];
+    }
+    Pairs[2*i] = lo;
+    Pairs[2*i+1] = hi;
+  }
+  return 2 * Blocks;
+}
+
+
+bool ref_save                           // capture on screen, replacing any file
+(
+  const char* path,
+  const DSO_FRAME* Frame,                       // held by the caller throughout
+  const DSO_SET* View,                            // timing it is shown with ...
+  const DSO_AXIS* Axis,                                 // ... and where it lies
+  const DSO_CHANNEL* Channel1,
+  const DSO_CHANNEL* Channel2,
+  const char* Name
+)
+{
+  const DSO_CHANNEL* Channel[2] = {Channel1, Channel2};
+  FRAME_CHANNEL Src;
+  REF_HEADER h;
+  uint64_t offset;
+  char tmp[320];
+  FILE* f;
+  bool ok = true;
+  int N = Frame->Settings.Dso.MemDepth;
+  int start;                                 // sample shown as trace point zero
+  int n;
+  int c;
+  int l;
+  int i;
+
+  if(N > HT6022_1MB || N < 2) return false;
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return false;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.Magic, Magic, sizeof(h.Magic));
+  h.Version = REF_VERSION;
+  h.Samples = N;
+  h.Ts = View->Ts;
+  h.Time = (double)time(NULL);
+  strncpy(h.Name, Name, REF_NAME - 1);
+
+  start = Frame->TriggerPoint < 8 ? 8 : Frame->TriggerPoint;       // as scanned
+  start += View->TriggerDelay - 8;
+  h.Trigger = Frame->TriggerPoint;               // untimed: on the sample found
+  if(Axis->Spans)                             // sample at t = 0, less the delay
+  {
+    h.Trigger =
+      start - (Axis->Span[0].t0 + View->TriggerOffset) / View->Ts -
+      View->TriggerDelay;
+    if(View->Tdiv <= 500e-9) h.Trigger += 4.2;        // sin(x)/x upsample delay
+  }
+  for(c = 0; c < 2; c++)
+  {
+    h.Volts[c] = Channel[c]->Scale->Step;
+    h.Zero[c] = Channel[c]->Scale->Zero - 128;
+  }
+
+  offset = sizeof(h);                          // codes, then each level in turn
+  for(c = 0; c < 2; c++)
+    for(l = 0; l < REF_LEVELS && (N >> l) > 0; l++)
+    {
+      h.Offset[c][l] = offset;
+      offset += l ? 2 * (N >> l) : N;
+      h.Levels = l + 1;
+    }
+
+  if((f = fopen(tmp, "wb")) == NULL) return false;
+  ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  for(c = 0; c < 2 && ok; c++)
+  {
+    Src = frame_channel(Frame, c);
+    for(i = 0; i < N; i++) Work[0][i] = Src.Data[i * Src.Stride];
+    ok = fwrite(Work[0], N, 1, f) == 1;
+    for(l = 1; l < (int)h.Levels && ok; l++)          // each from that below it
+    {
+      n = pyramid(Work[l & 1], Work[(l - 1) & 1], N >> l, l == 1);
+      ok = fwrite(Work[l & 1], n, 1, f) == 1;
+    }
+  }
+  ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if(fclose(f) != 0) ok = false;
+  if(ok && rename(tmp, path) == 0) return true;         // mappings keep the old
+  unlink(tmp);
+  return false;
+}
+
+
+bool ref_map(DSO_REF* Ref, const char* path)          // in place of any it held
+{
+  const REF_HEADER* h;
+  struct stat st;
+  void* p;
+  bool ok;
+  int fd;
+  int c;
+  int l;
+
+  ref_unmap(Ref);
+  if((fd = open(path, O_RDONLY)) < 0) return false;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(REF_HEADER))
+  {
+    close(fd);
+    return false;
+  }
+  p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);                                           // mapping keeps the file
+  if(p == MAP_FAILED) return false;
+
+  h = (const REF_HEADER*)p;
+  ok =
+    memcmp(h->Magic, Magic, sizeof(Magic)) == 0 &&
+    h->Version == REF_VERSION &&
+    h->Samples >= 2 && h->Samples <= HT6022_1MB &&
+    h->Levels >= 2 && h->Levels <= REF_LEVELS &&
+    isfinite(h->Trigger) && isfinite(h->Ts) && h->Ts > 0;           // a divisor
+  for(c = 0; c < 2 && ok; c++)
+    for(l = 0; l < (int)h->Levels && ok; l++)
+    {
+      ok =                                                 // not cut short, say
+        h->Offset[c][l] + (l ? 2 * (h->Samples >> l) : h->Samples) <=
+        (uint64_t)st.st_size;
+      Ref->Level[c][l] = (const uint8_t*)p + h->Offset[c][l];
+    }
+  if(!ok)
+  {
+    munmap(p, st.st_size);
+    memset(Ref, 0, sizeof(*Ref));
+    return false;
+  }
+
+  Ref->Header = h;
+  Ref->Size = st.st_size;
+  return true;
+}
+
+
+void ref_unmap(DSO_REF* Ref)
+{
+  if(Ref->Header) munmap((void*)Ref->Header, Ref->Size);
+  memset(Ref, 0, sizeof(*Ref));
+}
+
+
+int ref_trace                  // points now on screen, 0 if none, with own Axis
+(
+  const DSO_REF* Ref,
+  int channel,                                                         // 0 or 1
+  float* y,                                             // HT6022_1KB, divisions
+  DSO_AXIS* Axis,                                                // times of y[]
+  const DSO_SET* View,                                 // timebase and delay now
+  const DSO_CHANNEL* Channel                           // volts per division now
+)
+{
+  const REF_HEADER* h = Ref->Header;
+  const uint8_t* p;
+  const int columns = HT6022_1KB / 2;
+  double k0;                                     // sample at left of screen ...
+  double w;                                                 // ... and across it
+  double s;                                                // samples per column
+  double d;                                                          // delay, s
+  float scale;
+  float zero;
+  int N;
+  int first = -1;
+  int n = 0;
+  int l;
+  int b;
+  int e;
+  int j;
+  uint8_t lo;
+  uint8_t hi;
+
+  Axis->Spans = 0;
+  if(h == NULL) return 0;
+
+  N = h->Samples;
+  d = View->TriggerDelay * View->Ts + View->TriggerOffset;
+  k0 = h->Trigger + d / h->Ts;
+  w = 10 * View->Tdiv / h->Ts;
+  scale = h->Volts[channel] / (4 * Channel->Vdiv);
+  zero = Channel->VOffset - (128 + h->Zero[channel]) * scale;
+
+  if(w < HT6022_1KB - 2)                                  // samples as they are
+  {
+    b = (int)floor(k0);
+    e = (int)ceil(k0 + w) + 1;
+    if(b < 0) b = 0;
+    if(e > N) e = N;
+    p = Ref->Level[channel][0];
+    for(j = b; j < e; j++) y[n++] = p[j] * scale + zero;
+    Axis->dt = h->Ts;
+    Axis->Spans = n > 0;
+    Axis->Span[0].First = 0;
+    Axis->Span[0].End = n;
+    Axis->Span[0].t0 = (b - h->Trigger) * h->Ts - d;
+    return n;
+  }
+
+  s = w / columns;                                    // min and max of each ...
+  for(l = 1; l + 1 < (int)h->Levels && (2 << l) <= s; l++);
+  p = Ref->Level[channel][l];                          // ... from blocks of 2^l
+  for(j = 0; j < columns; j++)
+  {
+    b = (int)floor((k0 + j * s) / (1 << l));
+    e = (int)floor((k0 + (j + 1) * s) / (1 << l));
+    if(e <= b) e = b + 1;
+    if(b < 0) b = 0;
+    if(e > N >> l) e = N >> l;
+    if(b >= e)
+    {
+      if(first >= 0) break;                                      // past the end
+      continue;                                            // not yet reached it
+    }
+    if(first < 0) first = j;
+    lo = 255, hi = 0;
+    for(; b < e; b++)
+    {
+      if(p[2*b] < lo) lo = p[2*b];
+      if(p[2*b+1] > hi) hi = p[2*b+1];
+    }
+    y[2*n + (j & 1)] = lo * scale + zero;      // as roll_trace(): each pair ...
+    y[2*n + 1 - (j & 1)] = hi * scale + zero;              // ... joins the last
+    n++;
+  }
+  Axis->dt = s * h->Ts / 2;                           // as roll mode shows them
+  Axis->Spans = n > 0;
+  Axis->Span[0].First = 0;
+  Axis->Span[0].End = 2 * n;
+  Axis->Span[0].t0 = first * s * h->Ts;
+  return 2 * n;
+}
+
+#ifdef __cplusplus
+    }
+#endif
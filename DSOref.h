@@ -0,0 +1,94 @@
+/*
+  DSOref.h: reference waveforms overlaid on the live traces of the 6022
+  'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOREF_H
+#define DSOREF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "dso.h"
+#include "DSOframe.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define REF_VERSION 1
+#define REF_SLOTS 4                                              // REF1 to REF4
+#define REF_LEVELS 21                 // samples, then blocks of 2 to 1M of them
+#define REF_NAME 64
+#define REF_DIR "/.scope_refs"                           // library, in home dir
+
+
+typedef struct                                       // at the start of the file
+{
+  char Magic[8];                                                     // "DSOREF"
+  uint32_t Version;
+  uint32_t Samples;                                               // per channel
+  uint32_t Levels;                                 // of Offset[][] used, from 0
+  uint32_t Spare;
+  double Ts;                                                  // sample interval
+  double Trigger;                 // sample of the trigger edge, between samples
+  double Volts[2];                                     // per code, as displayed
+  double Zero[2];                                 // code offset of 0V, likewise
+  double Time;                                           // Unix time when saved
+  char Name[REF_NAME];
+  uint64_t Offset[2][REF_LEVELS];       // codes, then minimum and maximum pairs
+} REF_HEADER;
+
+typedef struct DSO_REF
+{
+  const REF_HEADER* Header;                        // mapped file, NULL if empty
+  size_t Size;                                                   // bytes mapped
+  const uint8_t* Level[2][REF_LEVELS];                       // into the mapping
+} DSO_REF;
+
+
+extern int ref_dir(char* path, int n);
+extern int ref_slot(char* path, int n, int slot);
+extern bool ref_save
+(
+  const char* path,
+  const DSO_FRAME* Frame,
+  const DSO_SET* View,
+  const DSO_AXIS* Axis,
+  const DSO_CHANNEL* Channel1,
+  const DSO_CHANNEL* Channel2,
+  const char* Name
+);
+extern bool ref_map(DSO_REF* Ref, const char* path);
+extern void ref_unmap(DSO_REF* Ref);
+extern int ref_trace
+(
+  const DSO_REF* Ref,
+  int channel,
+  float* y,
+  DSO_AXIS* Axis,
+  const DSO_SET* View,
+  const DSO_CHANNEL* Channel
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOREF_H
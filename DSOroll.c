@@ -0,0 +1,140 @@
+/*
+  DSOroll.c: strip chart acquisition, streamed from each transfer into a
+  ring of display columns.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  On slow timebases a triggered capture only appears once the whole of a
+  1MB record has been read, a second after the first sample of it.  In
+  roll mode the worker instead reads short transfers one after another
+  and reduces each, as it arrives, to the minimum and maximum of every
+  Decimate samples: one display column.  Completed columns go into a ring
+  so the display always shows the last ROLL_COLUMNS of them scrolling in
+  from the right, at most one transfer behind the input.  The 6022 starts
+  afresh for each read so there is a gap of a millisecond or so between
+  transfers; at 50ms/div a column is a millisecond long and it does not
+  show.  Memory is the ring, whatever the length of the run.
+
+  From 200ms/div to 100s/div there is only roll mode, at the 500K, 200K
+  and 100KSa rates: a capture would take up to 17 minutes.  A column can
+  then be several transfers in the making, so the one being built is
+  shown as it grows rather than appearing only once complete.
+*/
+
+
+#include "DSOroll.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+int roll_decimate(double Tdiv, double Ts)          // samples per display column
+{
+  int d = (int)(10 * Tdiv / (Ts * ROLL_COLUMNS) + 0.5);
+
+  return d < 1 ? 1 : d;
+}
+
+
+void roll_reset(DSO_ROLL* Roll, int Decimate)          // empty, at new timebase
+{
+  Roll->Decimate = Decimate;
+  Roll->Count = 0;
+  Roll->Min[0] = Roll->Min[1] = 255;
+  Roll->Max[0] = Roll->Max[1] = 0;
+  Roll->Columns = 0;
+}
+
+
+void roll_push                      // add samples, completing columns as it can
+(
+  DSO_ROLL* Roll,
+  const unsigned char* Data,                       // CH1 and CH2 pairs, as read
+  int Samples                                                 // of each channel
+)
+{
+  unsigned char lo0 = Roll->Min[0], hi0 = Roll->Max[0];
+  unsigned char lo1 = Roll->Min[1], hi1 = Roll->Max[1];
+  const unsigned char* p;
+  int n;
+  int c;
+  int i;
+
+  while(Samples > 0)
+  {
+    n = Roll->Decimate - Roll->Count;                  // rest of current column
+    if(n > Samples) n = Samples;
+    p = Data;
+    for(i = 0; i < 2 * n; i += 2)                    // reduction over the block
+    {
+      lo0 = p[i] < lo0 ? p[i] : lo0;
+      hi0 = p[i] > hi0 ? p[i] : hi0;
+      lo1 = p[i+1] < lo1 ? p[i+1] : lo1;
+      hi1 = p[i+1] > hi1 ? p[i+1] : hi1;
+    }
+    Data += 2 * n;
+    Samples -= n;
+    Roll->Count += n;
+    if(Roll->Count < Roll->Decimate) break;
+
+    c = Roll->Columns % ROLL_COLUMNS;                         // column complete
+    Roll->Lo[0][c] = lo0, Roll->Hi[0][c] = hi0;
+    Roll->Lo[1][c] = lo1, Roll->Hi[1][c] = hi1;
+    Roll->Columns++;
+    Roll->Count = 0;
+    lo0 = lo1 = 255;
+    hi0 = hi1 = 0;
+  }
+  Roll->Min[0] = lo0, Roll->Max[0] = hi0;
+  Roll->Min[1] = lo1, Roll->Max[1] = hi1;
+}
+
+
+int roll_trace             // codes of one channel, oldest first, two per column
+(
+  const DSO_ROLL* Roll,
+  int channel,                                                         // 0 or 1
+  float* CH                                        // at least HT6022_1KB points
+)
+{
+  const int partial = Roll->Count > 0;                 // column being built too
+  const unsigned int room = ROLL_COLUMNS - partial;
+  int n = Roll->Columns < room ? Roll->Columns : room;
+  unsigned int k = Roll->Columns - n;
+  int c;
+  int j;
+
+  for(j = 0; j < 2 * n; j += 2, k++)    // as minmax(): each pair joins the last
+  {
+    c = k % ROLL_COLUMNS;
+    CH[j + (k & 1)] = Roll->Lo[channel][c];
+    CH[j + 1 - (k & 1)] = Roll->Hi[channel][c];
+  }
+  if(partial)
+  {
+    CH[j + (k & 1)] = Roll->Min[channel];
+    CH[j + 1 - (k & 1)] = Roll->Max[channel];
+    n++;
+  }
+  return 2 * n;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,61 @@
+/*
+  DSOroll.h: strip chart acquisition for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOROLL_H
+#define DSOROLL_H
+
+#include "HT6022.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define ROLL_COLUMNS (HT6022_1KB / 2)         // minimum and maximum: two points
+#define ROLL_READ HT6022_16KB              // samples per transfer, 16ms at 1MSa
+#define ROLL_SKIP 16                    // first few of each read may be rubbish
+
+
+typedef struct DSO_ROLL
+{
+  int Decimate;                                            // samples per column
+  int Count;                                // in the column being built, so far
+  unsigned char Min[2];                               // CH1 and CH2, so far ...
+  unsigned char Max[2];
+  unsigned char Lo[2][ROLL_COLUMNS];             // ... and of completed columns
+  unsigned char Hi[2][ROLL_COLUMNS];
+  unsigned int Columns;      // completed since reset, newest at Columns - 1 ...
+} DSO_ROLL;                                                // ... % ROLL_COLUMNS
+
+
+extern int roll_decimate(double Tdiv, double Ts);
+extern void roll_reset(DSO_ROLL* Roll, int Decimate);
+extern void roll_push
+(
+  DSO_ROLL* Roll,
+  const unsigned char* Data,
+  int Samples
+);
+extern int roll_trace(const DSO_ROLL* Roll, int channel, float* CH);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOROLL_H
@@ -0,0 +1,80 @@
+/*
+  DSOscale.c: one table per channel from which every code is converted to
+  volts and to the screen, so all that do so agree.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  A channel's VScale and Zero, set for its range by cal_channel(), give
+  volts; its Vdiv, VOffset and inversion then place them on screen.  The
+  tables of both are made again only when one of those has changed since
+  they were last made, which scale_update() checks on each frame at the
+  cost of five compares.  Math, mask testing and export look codes up in
+  them.  Traces are fractional codes once filtered, averaged or boxcar
+  decimated, and upsampled before they are scaled, so vectorise() takes
+  the Step and Zero each table was made from instead; being the same
+  float arithmetic, a whole code lands exactly on its table entry.  The
+  trigger level, its line and decode thresholds are scale_code() of a
+  voltage, the inverse.
+*/
+
+
+#include <string.h>
+#include "DSOscale.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+DSO_SCALE Scale1, Scale2;                                // made on first update
+
+
+bool scale_update(DSO_CHANNEL* Channel)                   // true if made afresh
+{
+  DSO_SCALE* s = Channel->Scale;
+  const double key[5] =
+  {
+    Channel->VScale, Channel->Zero, Channel->Vdiv, Channel->VOffset,
+    Channel->Inv ? -1.0 : 1.0
+  };
+  int i;
+
+  if(!memcmp(key, s->Key, sizeof(key))) return false;
+  memcpy(s->Key, key, sizeof(key));
+
+  s->Step = Channel->VScale / 128;
+  s->Zero = 128 + Channel->Zero;
+  s->ScreenStep = s->Step / (4 * Channel->Vdiv) * key[4];
+  s->ScreenZero = Channel->VOffset - s->Zero * s->ScreenStep;
+  for(i = 0; i < 256; i++)
+  {
+    s->Volts[i] = (i - s->Zero) * s->Step;
+    s->Screen[i] = s->ScreenZero + s->ScreenStep * i;          // as vectorise()
+  }
+  return true;
+}
+
+
+double scale_code(const DSO_SCALE* Scale, double volts)       // fractional code
+{
+  return Scale->Zero + volts / Scale->Step;
+}
+
+#ifdef __cplusplus
+    }
+#endif
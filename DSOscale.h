@@ -0,0 +1,54 @@
+/*
+  DSOscale.h: conversion of the codes of each channel of the 6022 'scope
+  to volts and to the screen.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOSCALE_H
+#define DSOSCALE_H
+
+#include <stdbool.h>
+#include "dso.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+typedef struct DSO_SCALE                           // one channel, as now set up
+{
+  float Volts[256];                                     // each code, calibrated
+  float Screen[256];                             // each code as drawn, +-1 full
+  float Step;                                     // volts from one code to next
+  float Zero;                                          // code of 0V, fractional
+  float ScreenStep;                        // as Step on screen, < 0 if inverted
+  float ScreenZero;                                       // screen at code zero
+  double Key[5];                          // VScale, Zero, Vdiv, VOffset and Inv
+} DSO_SCALE;
+
+
+extern DSO_SCALE Scale1, Scale2;
+
+extern bool scale_update(DSO_CHANNEL* Channel);
+extern double scale_code(const DSO_SCALE* Scale, double volts);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOSCALE_H
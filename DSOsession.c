@@ -0,0 +1,160 @@
+/*
+  DSOsession.c: settings and last capture kept across restarts, written
+  whole and atomically so a crash leaves either the old or the new file.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  The session is a header, the SESSION structure as it lies in memory and,
+  when stopped on a capture, the interleaved bytes of that capture: a few
+  hundred bytes, or up to 2MB.  It is written to path.tmp, flushed to disk
+  and renamed over the old file, so a crash or power cut part way through
+  leaves the previous session intact.  The header carries the structure
+  size and a checksum of each part; a file from another build, or one cut
+  short, is ignored rather than half restored.  The capture is read on its
+  own so the settings may be applied before it is loaded.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "DSOsession.h"
+#include "DSOutils.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static const char Magic[8] = "DSOSES";
+
+
+static uint32_t fnv1a(const void* Data, int Bytes)         // 32 bit FNV-1a hash
+{
+  const unsigned char* p = (const unsigned char*)Data;
+  uint32_t h = 2166136261u;
+  int i;
+
+  for(i = 0; i < Bytes; i++) h = (h ^ p[i]) * 16777619u;
+  return h;
+}
+
+
+int session_path(char* path, int n)                          // ~/.scope_session
+{
+  return get_home_path(path, SESSION_FILE, n);
+}
+
+
+bool session_write                            // replaces the file, or leaves it
+(
+  const char* path,
+  const SESSION* Session,
+  const unsigned char* Data                           // Session->Bytes, or NULL
+)
+{
+  SESSION_HEADER h;
+  char tmp[160];
+  FILE* f;
+  bool ok;
+
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return false;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.Magic, Magic, sizeof(h.Magic));
+  h.Version = SESSION_VERSION;
+  h.Size = sizeof(SESSION);
+  h.Check = fnv1a(Session, sizeof(SESSION));
+  h.CaptureCheck = Data ? fnv1a(Data, Session->Bytes) : 0;
+
+  if((f = fopen(tmp, "wb")) == NULL) return false;
+  ok =
+    fwrite(&h, sizeof(h), 1, f) == 1 &&
+    fwrite(Session, sizeof(SESSION), 1, f) == 1 &&
+    (!Data || !Session->Bytes || fwrite(Data, Session->Bytes, 1, f) == 1) &&
+    fflush(f) == 0 &&
+    fsync(fileno(f)) == 0;                     // on disk before it replaces ...
+  if(fclose(f) != 0) ok = false;
+  if(ok && rename(tmp, path) == 0) return true;      // ... the previous session
+  unlink(tmp);
+  return false;
+}
+
+
+static FILE* session_open(const char* path, SESSION_HEADER* h)
+{
+  FILE* f;
+
+  if((f = fopen(path, "rb")) == NULL) return NULL;
+  if
+  (
+    fread(h, sizeof(*h), 1, f) != 1 ||
+    memcmp(h->Magic, Magic, sizeof(Magic)) != 0 ||
+    h->Version != SESSION_VERSION ||
+    h->Size != sizeof(SESSION)                            // another build of it
+  )
+  {
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+
+bool session_read(const char* path, SESSION* Session)       // settings, checked
+{
+  SESSION_HEADER h;
+  FILE* f;
+  bool ok;
+
+  if((f = session_open(path, &h)) == NULL) return false;
+  ok =
+    fread(Session, sizeof(SESSION), 1, f) == 1 &&
+    fnv1a(Session, sizeof(SESSION)) == h.Check &&
+    Session->Bytes >= 0 && Session->Bytes <= 2 * HT6022_1MB;
+  fclose(f);
+  if(!ok) memset(Session, 0, sizeof(SESSION));
+  return ok;
+}
+
+
+bool session_read_capture                          // as saved with the settings
+(
+  const char* path,
+  const SESSION* Session,                                 // from session_read()
+  unsigned char* Data                                 // room for Session->Bytes
+)
+{
+  SESSION_HEADER h;
+  FILE* f;
+  bool ok;
+
+  if(Session->Bytes == 0) return false;
+  if((f = session_open(path, &h)) == NULL) return false;
+  ok =
+    fseek(f, sizeof(h) + sizeof(SESSION), SEEK_SET) == 0 &&
+    fread(Data, Session->Bytes, 1, f) == 1 &&
+    fnv1a(Data, Session->Bytes) == h.CaptureCheck;
+  fclose(f);
+  return ok;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,102 @@
+/*
+  DSOsession.h: settings and last capture kept across restarts of the
+  6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOSESSION_H
+#define DSOSESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dso.h"
+#include "DSOsettings.h"
+#include "DSOfilter.h"
+#include "DSOaverage.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define SESSION_VERSION 1
+#define SESSION_FILE "/.scope_session"                      // in home directory
+
+
+typedef struct                                       // at the start of the file
+{
+  char Magic[8];                                                     // "DSOSES"
+  uint32_t Version;
+  uint32_t Size;                                 // sizeof(SESSION) when written
+  uint32_t Check;                                   // FNV-1a of the SESSION ...
+  uint32_t CaptureCheck;                      // ... and of the capture after it
+} SESSION_HEADER;
+
+typedef struct                                // controls as they were last left
+{
+  int Sampling;                                          // comboSampling, TDIV_
+  int Range[2];                                       // comboBoxV1div and V2div
+  int VarMode[2];                         // comboBoxMode1 and 2: position, gain
+  int Cursor[2];                                   // dialCursorV1 and V2 values
+  int Trigger;                                           // dialTrigger: 0 - 100
+  int Delay;                                               // dialDelay position
+  int Mode;                                  // comboBox_4: AUTO, NORMAL, SINGLE
+  bool Dots;                                                  // display options
+  bool Raster;
+  DSO_SET Dso;                                       // timing, delay and status
+  DSO_SETTINGS Setup;                          // trigger, holdoff, roll and ETS
+  DSO_CHANNEL Channel[2];                     // Filter and Average are not kept
+  struct
+  {
+    FILTER_TYPE_TypeDef Type;
+    FILTER_DESIGN_TypeDef Design;
+    double Fc;
+    double Q;
+    int Order;
+  } Filter[2];                                      // designed again on restore
+  struct
+  {
+    AVERAGE_TYPE_TypeDef Type;
+    int Shots;
+  } Average[2];                                          // restarted on restore
+  DSO_SETTINGS Capture;                      // as pinned to the capture, if any
+  int TriggerPoint;
+  unsigned int Sequence;                         // worker's Frame count as read
+  int Bytes;                          // interleaved capture after this, or zero
+} SESSION;
+
+
+extern int session_path(char* path, int n);
+extern bool session_write
+(
+  const char* path,
+  const SESSION* Session,
+  const unsigned char* Data
+);
+extern bool session_read(const char* path, SESSION* Session);
+extern bool session_read_capture
+(
+  const char* path,
+  const SESSION* Session,
+  unsigned char* Data
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOSESSION_H
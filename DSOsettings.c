@@ -0,0 +1,104 @@
+/*
+  DSOsettings.c: versioned acquisition settings, published by the GUI and
+  pinned by each acquisition thread to the frame it captures.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  The GUI thread is the only writer.  Each change is copied into the next
+  slot of a small ring which is then made current with one atomic pointer
+  store, so a reader never sees a half written set of controls.  Readers
+  copy the current slot and check its Version is unchanged, and non zero,
+  after the copy; should the GUI lap the ring during the copy the check
+  fails and the copy is simply taken again.  Nothing is ever freed and
+  neither side waits on a lock.  The copy then travels with the frame it
+  was captured under so the display, mask test and decoders format that
+  frame with the MemDepth and sample rate it actually has.
+
+  Sample rate and input ranges travel the same way.  Only the latest set
+  is ever applied, so a dial swept through several positions costs one
+  set of control transfers when the worker next gets to the device rather
+  than one per step, and they no longer interleave with its bulk reads.
+*/
+
+
+#include "DSOsettings.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static DSO_SETTINGS Ring[SETTINGS_RING];
+static DSO_SETTINGS* Current;                        // NULL until first publish
+static unsigned int Published;                             // GUI thread's count
+
+
+void settings_publish(const DSO_SETTINGS* Settings)      // from GUI thread only
+{
+  DSO_SETTINGS* s = &Ring[++Published % SETTINGS_RING];
+  DSO_SETTINGS copy = *Settings;
+
+  if(Published == 0) Published++;                    // zero marks a slot in use
+  __atomic_store_n(&s->Version, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);         // readers see it invalid ...
+  copy.Version = 0;
+  *s = copy;                                        // ... while it is rewritten
+  __atomic_store_n(&s->Version, Published, __ATOMIC_RELEASE);
+  __atomic_store_n(&Current, s, __ATOMIC_RELEASE);
+}
+
+
+unsigned int settings_pin(DSO_SETTINGS* Pinned)     // copy of latest, 0 if none
+{
+  DSO_SETTINGS* s;
+  unsigned int v;
+
+  do
+  {
+    s = __atomic_load_n(&Current, __ATOMIC_ACQUIRE);
+    if(s == NULL) return 0;
+    v = __atomic_load_n(&s->Version, __ATOMIC_ACQUIRE);
+    *Pinned = *s;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  }
+  while(v == 0 || __atomic_load_n(&s->Version, __ATOMIC_RELAXED) != v);
+
+  Pinned->Version = v;
+  return v;
+}
+
+
+void settings_view              // how to format a frame: controls, but its data
+(
+  DSO_SET* View,                                        // timing to format with
+  const DSO_SET* Live,                                 // as set by the controls
+  const DSO_SETTINGS* Frame                    // as pinned when it was captured
+)
+{
+  if(Frame->Dso.Ts != Live->Ts)                    // sample rate changed since:
+    *View = Frame->Dso;                                   // show it as captured
+  else
+  {                              // same data, so stored traces can be re-viewed
+    *View = *Live;
+    View->MemDepth = Frame->Dso.MemDepth;            // but never beyond its end
+  }
+}
+
+#ifdef __cplusplus
+    }
+#endif
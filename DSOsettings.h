@@ -0,0 +1,68 @@
+/*
+  DSOsettings.h: acquisition settings shared between the GUI and the
+  acquisition threads of the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOSETTINGS_H
+#define DSOSETTINGS_H
+
+#include <stdbool.h>
+#include "dso.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define SETTINGS_RING 8              // published copies before a slot is reused
+
+
+typedef struct DSO_SETTINGS
+{
+  unsigned int Version;               // publication count, zero while rewritten
+  unsigned int Arm;                    // changed when Mode is to be (re)applied
+  DSO_SET Dso;                                 // timing and delay, as published
+  DSO_MODE_TypeDef Mode;                  // HOLD when stopped, else as Dso.Mode
+  bool Roll;                      // stream into a strip chart, see DSOroll.c
+  bool Ets;                            // equivalent time sampling, see DSOets.c
+  int TriggerEdge;                          // 0 (falling edge), 1 (rising edge)
+  int TriggerChannel;                            // 0 (Channel 1), 1 (Channel 2)
+  unsigned char TriggerLevel;                                         // 0 - 255
+  int Holdoff;                           // delay in ms between successive reads
+  unsigned int Config;                           // changed with SR or either IR
+  HT6022_SRTypeDef SR;                   // applied by each worker between reads
+  HT6022_IRTypeDef IR[2];                                  // CH1 and CH2 ranges
+} DSO_SETTINGS;
+
+
+extern DSO_SETTINGS Setup;              // GUI thread's copy, see mainwindow.cpp
+
+extern void settings_publish(const DSO_SETTINGS* Settings);
+extern unsigned int settings_pin(DSO_SETTINGS* Pinned);
+extern void settings_view
+(
+  DSO_SET* View,                                        // timing to format with
+  const DSO_SET* Live,                                 // as set by the controls
+  const DSO_SETTINGS* Frame                    // as pinned when it was captured
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOSETTINGS_H
@@ -0,0 +1,274 @@
+/*
+  DSOsim.c: simulated signal source with edges at known positions, for
+  measuring trigger performance without a 'scope attached.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Samples come interleaved as from HT6022_ReadData(): CH1 the signal and
+  CH2 its inverse, rounded to codes with Gaussian noise (the sum of four
+  uniform deviates is close enough) and clipped at the ends of the range.
+  Being a stream, consecutive reads follow on with no gap, so the k th
+  rising crossing of Offset is always at exactly sim_edge(k).
+
+  sim_trigger_test() feeds the stream in transfers of Block samples to
+  the trigger detector and matches what it reports against those known
+  edges, within a quarter period.  With Carry the detector follows the
+  stream across transfers; without, each transfer is searched afresh,
+  skipping its first 8 samples, as the triggered reads are.  Edges from
+  the first period of the stream, before it can arm, are not counted.
+
+  sim_jitter_test() takes separate 1KB captures at random phase, as the
+  triggered reads are, and compares where trigger_time() puts the first
+  edge of each with where it truly is.  The rms difference is the jitter
+  the display would show in an overlay of those captures.
+
+  sim_cal_test() runs a gain calibration on the calibrator, a square wave
+  of Sim's Period from 0V to Volts, through inputs with the offsets and
+  gains of Inject, and compares what is found with them.
+*/
+
+
+#include <math.h>
+#include "DSOsim.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+static unsigned char Buffer[2 * SIM_BLOCK];                // GUI thread's tests
+static DSO_CAL_RUN Run;
+static DSO_CAL From;
+
+
+static double uniform(DSO_SIM* Sim)                        // xorshift32, 0 to 1
+{
+  uint32_t x = Sim->Seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  Sim->Seed = x;
+  return x / 4294967296.0;
+}
+
+
+static double gauss(DSO_SIM* Sim)                         // zero mean, unit rms
+{
+  return (uniform(Sim) + uniform(Sim) + uniform(Sim) + uniform(Sim) - 2) *
+    sqrt(3.0);
+}
+
+
+static unsigned char code(double v)                       // rounded and clipped
+{
+  v = floor(v + 0.5);
+  return v < 0 ? 0 : v > 255 ? 255 : (unsigned char)v;
+}
+
+
+void sim_read(DSO_SIM* Sim, unsigned char* Data, int Samples)   // as a transfer
+{
+  double t;
+  double f;
+  double v;
+  int i;
+
+  for(i = 0; i < Samples; i++)
+  {
+    t = (Sim->Position + i - Sim->Phase) / Sim->Period;             // in cycles
+    f = t - floor(t);
+    if(Sim->Shape == SIM_SQUARE) v = f < 0.5 ? 1 : -1;
+    else v = sin(2 * M_PI * f);
+    v *= Sim->Amplitude;
+    if(Sim->Noise > 0) v += Sim->Noise * gauss(Sim);
+    Data[2 * i] = code(Sim->Offset + v);
+    Data[2 * i + 1] = code(Sim->Offset - v);
+  }
+  Sim->Position += Samples;
+}
+
+
+double sim_edge(const DSO_SIM* Sim, int64_t k)  // k th rising crossing, samples
+{
+  return Sim->Phase + k * Sim->Period;
+}
+
+
+void sim_trigger_test                // missed and false triggers on CH1, rising
+(
+  DSO_SIM* Sim,
+  int Block,                               // samples per transfer, to SIM_BLOCK
+  int Blocks,
+  bool Carry,                     // detector state carried from one to the next
+  int Hysteresis,
+  SIM_TRIGGER_STATS* Stats
+)
+{
+  DSO_TRIGGER t;
+  double from;                                          // time to have armed by
+  double to;                       // and by which an edge must be seen, samples
+  double e;
+  int64_t k;
+  int64_t last = INT64_MIN;
+  int b;
+
+  if(Block > SIM_BLOCK) Block = SIM_BLOCK;
+  from = Sim->Position + Sim->Period;
+  to = Sim->Position + (double)Block * Blocks - Sim->Period / 2;
+  Stats->Edges = Stats->Found = Stats->False = 0;
+  trigger_reset(&t, 1, code(Sim->Offset), Hysteresis);
+  trigger_restart(&t, Sim->Position);
+
+  for(b = 0; b < Blocks; b++)
+  {
+    if(Carry)
+    {
+      sim_read(Sim, Buffer, Block);
+      trigger_feed(&t, Buffer, 2, Block);
+    }
+    else
+    {
+      trigger_restart(&t, Sim->Position + 8);          // as the triggered reads
+      sim_read(Sim, Buffer, Block);
+      trigger_feed(&t, Buffer + 16, 2, Block - 8);
+    }
+    while(trigger_next(&t) >= 0)
+    {
+      k = (int64_t)floor((t.At - Sim->Phase) / Sim->Period + 0.5);
+      e = sim_edge(Sim, k);
+      if(e < from || e >= to) continue;             // neither end of the stream
+      if(k > last && fabs(t.At - e) <= Sim->Period / 4)
+        Stats->Found++, last = k;
+      else Stats->False++;
+    }
+  }
+
+  for(k = (int64_t)ceil((from - Sim->Phase) / Sim->Period);; k++)
+    if(sim_edge(Sim, k) < to) Stats->Edges++;
+    else break;
+  Stats->Missed = Stats->Edges > Stats->Found ? Stats->Edges - Stats->Found : 0;
+}
+
+
+void sim_jitter_test             // crossing times of CH1 rising edges, as shown
+(
+  DSO_SIM* Sim,                                      // Phase and Position reset
+  int Captures,
+  TRIGGER_INTERP_TypeDef Interp,
+  SIM_JITTER_STATS* Stats
+)
+{
+  DSO_TRIGGER t;
+  TRIGGER_TIME time;
+  double e;
+  double sum = 0;
+  int estimates = 0;
+  int c;
+  int i;
+
+  Stats->Captures = 0;
+  Stats->Worst = Stats->Estimate = 0;
+  trigger_time_reset(&time);
+  for(c = 0; c < Captures; c++)
+  {
+    Sim->Position = 0;
+    Sim->Phase = uniform(Sim) * Sim->Period;           // sample clock unrelated
+    sim_read(Sim, Buffer, HT6022_1KB);
+    trigger_reset(&t, 1, code(Sim->Offset), TRIGGER_HYSTERESIS);
+    trigger_feed(&t, Buffer + 16, 2, HT6022_1KB - 8);
+    if((i = trigger_next(&t)) < 0) continue;
+    if
+    (
+      !trigger_time
+      (
+        &time, Buffer, 2, HT6022_1KB, i + 8, 1, Sim->Offset, Interp
+      )
+    ) continue;
+    e = time.Crossing - Sim->Phase;                     // from the nearest edge
+    e -= Sim->Period * floor(e / Sim->Period + 0.5);
+    sum += e * e;
+    if(fabs(e) > Stats->Worst) Stats->Worst = fabs(e);
+    if(time.Count == TRIGGER_RECENT)                      // once it has settled
+      Stats->Estimate += time.Jitter, estimates++;
+    Stats->Captures++;
+  }
+  if(!Stats->Captures) return;
+  Stats->Error = sqrt(sum / Stats->Captures);
+  if(estimates) Stats->Estimate /= estimates;
+}
+
+
+void sim_cal_test                     // errors injected into both inputs, found
+(
+  DSO_SIM* Sim,                            // Period, Phase, Noise and Seed used
+  const DSO_CAL* Inject,                          // as the inputs truly are ...
+  double Volts,                                         // ... on the calibrator
+  SIM_CAL_STATS* Stats
+)
+{
+  FRAME_CHANNEL Src[2];
+  unsigned int bit;
+  double k;
+  double f;
+  double v;
+  double e;
+  int r;
+  int c;
+  int i;
+
+  cal_default(&From);
+  cal_start(&Run, &From, true, Volts);
+  while(Run.Range < CAL_RANGES)             // an acquisition on the range asked
+  {
+    r = Run.Range;
+    for(c = 0; c < 2; c++)
+    {
+      k = Inject->Gain[c][r] / cal_nominal(r);                 // codes per volt
+      for(i = 0; i < SIM_BLOCK; i++)
+      {
+        f = (Sim->Position + i - Sim->Phase) / Sim->Period;
+        v = f - floor(f) < 0.5 ? Volts : 0;
+        Buffer[2 * i + c] =
+          code(128 + Inject->Offset[c][r] + k * v + Sim->Noise * gauss(Sim));
+      }
+      Src[c].Data = Buffer + c;
+      Src[c].Stride = 2;
+      Src[c].Length = SIM_BLOCK;
+    }
+    Sim->Position += SIM_BLOCK;
+    cal_feed(&Run, &Src[0], &Src[1]);
+  }
+
+  Stats->Offsets = Run.Offsets;
+  Stats->Gains = Run.Gains;
+  Stats->Offset = Stats->Gain = 0;
+  for(c = 0; c < 2; c++)
+    for(r = 0; r < CAL_RANGES; r++)
+    {
+      bit = 1u << (c * CAL_RANGES + r);
+      e = fabs(Run.Result.Offset[c][r] - Inject->Offset[c][r]);
+      if(Run.Offsets & bit && e > Stats->Offset) Stats->Offset = e;
+      e = fabs(Run.Result.Gain[c][r] / Inject->Gain[c][r] - 1);
+      if(Run.Gains & bit && e > Stats->Gain) Stats->Gain = e;
+    }
+}
+
+#ifdef __cplusplus
+    }
+#endif
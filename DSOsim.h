@@ -0,0 +1,110 @@
+/*
+  DSOsim.h: simulated signal source for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOSIM_H
+#define DSOSIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "HT6022.h"
+#include "DSOtrigger.h"
+#include "DSOcal.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define SIM_BLOCK HT6022_64KB                  // largest transfer fed to a test
+
+
+typedef enum
+{
+  SIM_SINE,
+  SIM_SQUARE
+} SIM_SHAPE_TypeDef;
+
+typedef struct DSO_SIM
+{
+  SIM_SHAPE_TypeDef Shape;
+  double Period;                                            // samples per cycle
+  double Phase;                      // first rising crossing of Offset, samples
+  double Amplitude;                                               // codes, peak
+  double Offset;                                      // codes, 128 is mid scale
+  double Noise;                                                     // codes rms
+  uint32_t Seed;                                  // noise generator, never zero
+  uint64_t Position;                              // stream index of next sample
+} DSO_SIM;
+
+typedef struct
+{
+  unsigned int Edges;                               // known to be in the stream
+  unsigned int Found;                               // reported near one of them
+  unsigned int Missed;
+  unsigned int False;                     // reported, but not near a known edge
+} SIM_TRIGGER_STATS;
+
+typedef struct
+{
+  unsigned int Captures;                                   // with an edge found
+  double Error;                      // rms of crossing less known edge, samples
+  double Worst;
+  double Estimate;              // mean of trigger_time() Jitter, for comparison
+} SIM_JITTER_STATS;
+
+typedef struct
+{
+  unsigned int Offsets;                  // found, bit per channel and range ...
+  unsigned int Gains;                                  // ... as DSO_CAL_RUN has
+  double Offset;                              // worst error of those, codes ...
+  double Gain;                                               // ... and fraction
+} SIM_CAL_STATS;
+
+
+extern void sim_read(DSO_SIM* Sim, unsigned char* Data, int Samples);
+extern double sim_edge(const DSO_SIM* Sim, int64_t k);
+extern void sim_trigger_test
+(
+  DSO_SIM* Sim,
+  int Block,
+  int Blocks,
+  bool Carry,
+  int Hysteresis,
+  SIM_TRIGGER_STATS* Stats
+);
+extern void sim_jitter_test
+(
+  DSO_SIM* Sim,
+  int Captures,
+  TRIGGER_INTERP_TypeDef Interp,
+  SIM_JITTER_STATS* Stats
+);
+extern void sim_cal_test
+(
+  DSO_SIM* Sim,
+  const DSO_CAL* Inject,
+  double Volts,
+  SIM_CAL_STATS* Stats
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOSIM_H
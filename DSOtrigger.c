@@ -0,0 +1,305 @@
+/*
+  DSOtrigger.c: trigger edge detector, with its hysteresis carried from
+  one transfer to the next.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  An edge is the first sample at or beyond the trigger level after the
+  signal has been more than the hysteresis on the other side of it.  The
+  search for each transfer used to start afresh, disarmed, so an edge
+  armed in one transfer and crossing in the next was never seen.  Here
+  the armed state and the stream position travel with the detector:
+  feed it each transfer in turn and take edges from trigger_next() until
+  it returns -1, each found once, at its index in the transfer and in
+  the whole stream.  Triggered captures are separate acquisitions, not a
+  stream, so the worker calls trigger_restart() before each of those.
+  The 6022 loses about a millisecond between roll transfers; trigger_gap()
+  moves the stream position past it, so indices stay times.  An edge that
+  crosses in the gap is found at the first sample after it, and one that
+  both arms and crosses within it is missed.
+
+  trigger_time() then finds where between samples the signal crossed the
+  level, interpolating the raw codes linearly, by Catmull-Rom cubic or by
+  windowed sinc and solving for the level by regula falsi.  Each method
+  passes through the samples themselves, so the crossing stays within the
+  interval the samples bracket.  It times the next edge of the capture
+  the same way: the spread of that interval over recent captures is the
+  error of two crossings, noise, quantisation and interpolation alike, so
+  divided by root two it estimates the jitter an overlay of them shows.
+  Jitter of the signal itself is included, as it would be on screen.
+*/
+
+
+#include <math.h>
+#include "DSOtrigger.h"
+
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+void trigger_reset                         // new settings, at stream position 0
+(
+  DSO_TRIGGER* Trigger,
+  int Edge,                                 // 0 (falling edge), 1 (rising edge)
+  unsigned char Level,
+  int Hysteresis
+)
+{
+  Trigger->Edge = Edge;
+  Trigger->Level = Level;
+  if(Edge) Trigger->Arm = Level > Hysteresis ? Level - Hysteresis : 0;
+  else Trigger->Arm = Level < 255 - Hysteresis ? Level + Hysteresis : 255;
+  Trigger->Edges = 0;
+  trigger_restart(Trigger, 0);
+}
+
+
+void trigger_restart(DSO_TRIGGER* Trigger, uint64_t Position)  // not contiguous
+{
+  Trigger->Armed = false;
+  Trigger->Data = 0;
+  Trigger->Samples = 0;
+  Trigger->Next = 0;
+  Trigger->Position = Position;                   // of the next transfer fed in
+}
+
+
+void trigger_gap                        // samples lost before the next transfer
+(
+  DSO_TRIGGER* Trigger,
+  uint64_t Samples
+)
+{
+  Trigger->Position += Samples;                         // still armed across it
+}
+
+
+void trigger_feed                   // next transfer, following on from the last
+(
+  DSO_TRIGGER* Trigger,
+  const unsigned char* Data,                      // first sample of the channel
+  int Stride,                                      // bytes from one to the next
+  int Samples
+)
+{
+  Trigger->Position += Trigger->Samples;
+  Trigger->Data = Data;
+  Trigger->Stride = Stride;
+  Trigger->Samples = Samples;
+  Trigger->Next = 0;
+}
+
+
+int trigger_next               // index in transfer of the next edge, -1 if none
+(
+  DSO_TRIGGER* Trigger
+)
+{
+  const unsigned char* d = Trigger->Data;
+  const int s = Trigger->Stride;
+  const int n = Trigger->Samples;
+  const unsigned char level = Trigger->Level;
+  const unsigned char arm = Trigger->Arm;
+  bool armed = Trigger->Armed;
+  int i = Trigger->Next;
+
+  if(Trigger->Edge)
+  {
+    for(; i < n; i++)
+    {
+      if(d[s * i] < arm) armed = true;
+      else if(armed && d[s * i] >= level) break;
+    }
+  }
+  else
+  {
+    for(; i < n; i++)
+    {
+      if(d[s * i] > arm) armed = true;
+      else if(armed && d[s * i] <= level) break;
+    }
+  }
+
+  if(i >= n)                                         // stays armed for the next
+  {
+    Trigger->Armed = armed;
+    Trigger->Next = n;
+    return -1;
+  }
+  Trigger->Armed = false;                          // once each edge, then rearm
+  Trigger->Next = i + 1;
+  Trigger->At = Trigger->Position + i;
+  Trigger->Edges++;
+  return i;
+}
+
+
+typedef struct                          // samples about a crossing, for value()
+{
+  const unsigned char* Data;
+  int Stride;
+  int Samples;
+  int k;                                    // crossing lies between k and k + 1
+  TRIGGER_INTERP_TypeDef Interp;
+} CROSSING;
+
+
+static double sample(const CROSSING* c, int i)        // clamped to the transfer
+{
+  if(i < 0) i = 0;
+  if(i >= c->Samples) i = c->Samples - 1;
+  return c->Data[c->Stride * i];
+}
+
+
+static double lanczos(double x)
+{
+  if(fabs(x) < 1e-9) return 1;
+  if(fabs(x) >= TRIGGER_TAPS) return 0;
+  return TRIGGER_TAPS * sin(M_PI * x) * sin(M_PI * x / TRIGGER_TAPS) /
+    (M_PI * M_PI * x * x);
+}
+
+
+static double value(const CROSSING* c, double f)        // at k + f, 0 <= f <= 1
+{
+  double p0, p1, p2, p3;
+  double v = 0;
+  int m;
+
+  p1 = sample(c, c->k);
+  p2 = sample(c, c->k + 1);
+  switch(c->Interp)
+  {
+    case TRIGGER_CUBIC:
+      p0 = sample(c, c->k - 1);
+      p3 = sample(c, c->k + 2);
+      return p1 + 0.5 * f * (p2 - p0 + f * (2 * p0 - 5 * p1 + 4 * p2 - p3 +
+        f * (3 * (p1 - p2) + p3 - p0)));
+    case TRIGGER_SINC:
+      for(m = 1 - TRIGGER_TAPS; m <= TRIGGER_TAPS; m++)
+        v += sample(c, c->k + m) * lanczos(f - m);
+      return v;
+    default:
+      return p1 + f * (p2 - p1);
+  }
+}
+
+
+static bool crossing                         // fractional sample index, near At
+(
+  CROSSING* c,
+  int At,
+  int Edge,
+  double Level,
+  double* Crossing
+)
+{
+  const double sign = Edge ? 1 : -1;                  // so all edges are rising
+  double f0 = 0, f1 = 1, f = 0;
+  double v0, v1, v;
+  int side = 0;
+  int n;
+
+  for(c->k = At - 2; c->k <= At + 1; c->k++)       // level may be between codes
+    if
+    (
+      c->k >= 0 && c->k + 1 < c->Samples &&
+      sign * (sample(c, c->k) - Level) < 0 &&
+      sign * (sample(c, c->k + 1) - Level) >= 0
+    ) break;
+  if(c->k > At + 1) return false;
+
+  v0 = sign * (sample(c, c->k) - Level);
+  v1 = sign * (sample(c, c->k + 1) - Level);
+  for(n = 0; n < 40 && f1 - f0 > 1e-6; n++)             // Illinois regula falsi
+  {
+    f = (f0 * v1 - f1 * v0) / (v1 - v0);
+    v = sign * (value(c, f) - Level);
+    if(v == 0) break;
+    if(v < 0)
+    {
+      f0 = f, v0 = v;
+      if(side == -1) v1 /= 2;
+      side = -1;
+    }
+    else
+    {
+      f1 = f, v1 = v;
+      if(side == 1) v0 /= 2;
+      side = 1;
+    }
+  }
+  *Crossing = c->k + f;
+  return true;
+}
+
+
+void trigger_time_reset(TRIGGER_TIME* Time)            // new signal or settings
+{
+  Time->Count = 0;
+  Time->Mean = Time->Var = Time->Jitter = 0;
+}
+
+
+bool trigger_time                  // crossing of edge At, and its jitter so far
+(
+  TRIGGER_TIME* Time,
+  const unsigned char* Data,                      // first sample of the channel
+  int Stride,                                      // bytes from one to the next
+  int Samples,
+  int At,                        // first sample beyond level, as trigger_next()
+  int Edge,                                 // 0 (falling edge), 1 (rising edge)
+  double Level,                                             // codes, fractional
+  TRIGGER_INTERP_TypeDef Interp
+)
+{
+  CROSSING c = {Data, Stride, Samples, 0, Interp};
+  DSO_TRIGGER t;
+  double next;
+  double d;
+  int i;
+  int n;
+
+  if(!crossing(&c, At, Edge, Level, &Time->Crossing)) return false;
+
+  trigger_reset                         // next edge of this capture, if any ...
+  (
+    &t, Edge, (unsigned char)(Level < 0 ? 0 : Level > 255 ? 255 : Level + 0.5),
+    TRIGGER_HYSTERESIS
+  );
+  trigger_restart(&t, At + 1);
+  trigger_feed(&t, Data + Stride * (At + 1), Stride, Samples - At - 1);
+  if((i = trigger_next(&t)) < 0) return true;
+  if(!crossing(&c, (int)t.At, Edge, Level, &next)) return true;
+
+  Time->Interval = next - Time->Crossing;         // ... suffers both crossings'
+  d = Time->Interval - Time->Mean;                        // errors, independent
+  if(Time->Count && fabs(d) > Time->Mean / 4) Time->Count = 0;     // new signal
+  if(!Time->Count) Time->Mean = Time->Interval, Time->Var = 0, d = 0;
+  n = Time->Count < TRIGGER_RECENT ? ++Time->Count : TRIGGER_RECENT;
+  Time->Mean += d / n;
+  Time->Var += (d * (Time->Interval - Time->Mean) - Time->Var) / n;
+  Time->Jitter = sqrt(Time->Var / 2);
+  return true;
+}
+
+#ifdef __cplusplus
+    }
+#endif
@@ -0,0 +1,103 @@
+/*
+  DSOtrigger.h: trigger edge detector for the 6022 'scope.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DSOTRIGGER_H
+#define DSOTRIGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define TRIGGER_HYSTERESIS 4                        // codes, for noise immunity
+#define TRIGGER_TAPS 8                 // each side of a sinc interpolated point
+#define TRIGGER_RECENT 16                     // captures in the jitter estimate
+
+
+typedef struct DSO_TRIGGER
+{
+  int Edge;                                 // 0 (falling edge), 1 (rising edge)
+  unsigned char Level;
+  unsigned char Arm;               // beyond this, away from Level, to arm again
+  bool Armed;                           // carried from one transfer to the next
+  const unsigned char* Data;                          // transfer being searched
+  int Stride;
+  int Samples;
+  int Next;                                             // sample to resume from
+  uint64_t Position;                     // stream index of the transfer's first
+  uint64_t At;                                // stream index of last edge found
+  unsigned int Edges;                                       // found since reset
+} DSO_TRIGGER;
+
+typedef enum
+{
+  TRIGGER_LINEAR,
+  TRIGGER_CUBIC,                                       // Catmull-Rom, 4 samples
+  TRIGGER_SINC                     // Lanczos windowed, 2 * TRIGGER_TAPS samples
+} TRIGGER_INTERP_TypeDef;
+
+typedef struct
+{
+  double Crossing;                      // of the level, fractional sample index
+  double Interval;                      // from it to the next edge, if any, ...
+  double Mean;                                       // ... over recent captures
+  double Var;
+  double Jitter;                               // rms error of Crossing, samples
+  unsigned int Count;                                   // captures in Mean, Var
+} TRIGGER_TIME;
+
+
+extern void trigger_reset
+(
+  DSO_TRIGGER* Trigger,
+  int Edge,
+  unsigned char Level,
+  int Hysteresis
+);
+extern void trigger_restart(DSO_TRIGGER* Trigger, uint64_t Position);
+extern void trigger_gap(DSO_TRIGGER* Trigger, uint64_t Samples);
+extern void trigger_feed
+(
+  DSO_TRIGGER* Trigger,
+  const unsigned char* Data,
+  int Stride,
+  int Samples
+);
+extern int trigger_next(DSO_TRIGGER* Trigger);
+extern void trigger_time_reset(TRIGGER_TIME* Time);
+extern bool trigger_time
+(
+  TRIGGER_TIME* Time,
+  const unsigned char* Data,
+  int Stride,
+  int Samples,
+  int At,
+  int Edge,
+  double Level,
+  TRIGGER_INTERP_TypeDef Interp
+);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif // DSOTRIGGER_H
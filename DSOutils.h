@@ -29,14 +29,16 @@
  extern "C" {
 #endif
 
-extern double Zero1[6];                 //offset null corrections, -127 to + 127
-extern double Zero2[6];
-extern double VScaleFactor;
-
-extern void do_cal(unsigned char* CH0, int Calibrate);
-extern int write_cal_file(void);
-extern int read_cal_file(void);
-extern void write_tracefile(unsigned char* CH0, int MemDepth);
+extern int get_home_path(char* path, const char* filename, int n);
+extern int write_trace
+(
+  const char* filename,
+  unsigned char* CH0,
+  int first,
+  int count,
+  double Ts
+);
+extern void write_tracefile(unsigned char* CH0, int MemDepth, double Ts);
 extern void float2engStr(char* strout, double value);
 
 #ifdef __cplusplus
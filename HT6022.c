@@ -25,6 +25,8 @@
 
 /*
   05/01/2018  P G Duesbury: Modified ReadData() to return raw interleaved traces
+              Calls on a closed device handle fail with NO_DEVICE, so the
+              device can come and go while the application runs
 */
 
 /* Includes ------------------------------------------------------------------*/
@@ -170,23 +172,25 @@ HT6022_ErrorTypeDef HT6022_FirmwareUpload (void)
   unsigned int Value;
   int n;
 
-  Dev_handle = libusb_open_device_with_vid_pid
-  (
-    NULL,
-    HT6022_FIRMWARE_VENDOR_ID + 1,
-    HT6022_MODEL
-  );
-  if (Dev_handle != 0)
-    return HT6022_LOADED;
-
-  Dev_handle = libusb_open_device_with_vid_pid
-  (
+  Dev_handle = libusb_open_device_with_vid_pid  /* bare 'scope first, so */
+  (                                            /* each of several is loaded */
     NULL,
     HT6022_FIRMWARE_VENDOR_ID,
     HT6022_MODEL
   );
   if (Dev_handle == 0)
-    return HT6022_ERROR_NO_DEVICE;
+  {
+    Dev_handle = libusb_open_device_with_vid_pid
+    (
+      NULL,
+      HT6022_FIRMWARE_VENDOR_ID + 1,
+      HT6022_MODEL
+    );
+    if (Dev_handle == 0)
+      return HT6022_ERROR_NO_DEVICE;
+    libusb_close(Dev_handle);
+    return HT6022_LOADED;
+  }
 
   if(libusb_kernel_driver_active(Dev_handle, 0) == 1)
     if(libusb_detach_kernel_driver(Dev_handle, 0) != 0)
@@ -248,6 +252,7 @@ HT6022_ErrorTypeDef HT6022_DeviceOpen (HT6022_DeviceTypeDef *Device)
   int DeviceIterator;
   int r;
   unsigned char Address;
+  unsigned char Free = 0x00;
 
   if (Device == NULL)
     return HT6022_ERROR_INVALID_PARAM;
@@ -263,7 +268,7 @@ HT6022_ErrorTypeDef HT6022_DeviceOpen (HT6022_DeviceTypeDef *Device)
   for(DeviceIterator = 0; DeviceIterator < DeviceCount; DeviceIterator++)
   {
     Address = libusb_get_device_address (DeviceList[DeviceIterator]);
-    if (HT6022_AddressList[Address] == 0)
+    if (__atomic_load_n(&HT6022_AddressList[Address], __ATOMIC_ACQUIRE) == 0)
       /* Get device descriptor*/
       if (libusb_get_device_descriptor(DeviceList[DeviceIterator], &desc) == 0)
       {
@@ -280,10 +285,19 @@ HT6022_ErrorTypeDef HT6022_DeviceOpen (HT6022_DeviceTypeDef *Device)
     return HT6022_ERROR_NO_DEVICE;
   }
 
+  /* Reserve the address: DeviceClose() may run on another thread */
+  if (!__atomic_compare_exchange_n(&HT6022_AddressList[Address], &Free, 0x01,
+    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    libusb_free_device_list(DeviceList, 1);
+    return HT6022_ERROR_NO_DEVICE;
+  }
+
   r = libusb_open(DeviceList[DeviceIterator], &DeviceHandle);
   libusb_free_device_list(DeviceList, 1);
   if (r != 0)
   {
+    __atomic_store_n(&HT6022_AddressList[Address], 0x00, __ATOMIC_RELEASE);
     if (r != HT6022_ERROR_NO_MEM && r != HT6022_ERROR_ACCESS)
       r = HT6022_ERROR_OTHER;
     return r;
@@ -293,16 +307,17 @@ HT6022_ErrorTypeDef HT6022_DeviceOpen (HT6022_DeviceTypeDef *Device)
     if(libusb_detach_kernel_driver(DeviceHandle, 0) != 0)
     {
       libusb_close(DeviceHandle);
+      __atomic_store_n(&HT6022_AddressList[Address], 0x00, __ATOMIC_RELEASE);
       return HT6022_ERROR_OTHER;
     }
 
   if(libusb_claim_interface(DeviceHandle, 0) != 0)
   {
     libusb_close(DeviceHandle);
+    __atomic_store_n(&HT6022_AddressList[Address], 0x00, __ATOMIC_RELEASE);
     return HT6022_ERROR_OTHER;
   }
 
-  HT6022_AddressList [Address] = 0x01;
   Device->Address      = Address;
   Device->DeviceHandle = DeviceHandle;
 
@@ -318,11 +333,12 @@ HT6022_ErrorTypeDef HT6022_DeviceOpen (HT6022_DeviceTypeDef *Device)
   */
 void HT6022_DeviceClose  (HT6022_DeviceTypeDef *Device)
 {
-  if (Device != NULL)
+  if (Device != NULL && Device->DeviceHandle != NULL)
   {
     libusb_release_interface(Device->DeviceHandle, 0);
     libusb_close(Device->DeviceHandle);
-    HT6022_AddressList[Device->Address] = 0x00;
+    __atomic_store_n
+      (&HT6022_AddressList[Device->Address], 0x00, __ATOMIC_RELEASE);
     Device->DeviceHandle = NULL;
     Device->Address = 0;
   }
@@ -359,6 +375,8 @@ HT6022_ErrorTypeDef HT6022_ReadData
 
   if ((!IS_HT6022_DATASIZE (DataSize)) || (Device == NULL) ||  (data == NULL))
     return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
 
   *data = HT6022_READ_CONTROL_DATA;
   r = libusb_control_transfer
@@ -408,7 +426,8 @@ HT6022_ErrorTypeDef HT6022_ReadData
 @verbatim
  ===============================================================================
                       Read and Write calibration value functions
-             NB: Read seems to corrupt EEPROM and returns variable data
+             NB: Read seems to corrupt EEPROM and returns variable data:
+             DSOcal.c reads only on request, twice, and trusts matching reads
  ===============================================================================
 @endverbatim
   * @{
@@ -429,6 +448,8 @@ HT6022_ErrorTypeDef HT6022_SetCalValues
 
   if ((!IS_HT6022_CVSIZE (CVSize)) || (Device == NULL) ||  (CalValues == NULL))
     return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
   r = libusb_control_transfer
   (
     Device->DeviceHandle,
@@ -464,6 +485,8 @@ HT6022_ErrorTypeDef HT6022_GetCalValues
 
   if ((!IS_HT6022_CVSIZE (CVSize)) || (Device == NULL) ||  (CalValues == NULL))
     return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
   r = libusb_control_transfer
   (
     Device->DeviceHandle,
@@ -512,6 +535,8 @@ HT6022_ErrorTypeDef HT6022_SetSR
 
   if ((!IS_HT6022_SR (SR)) || (Device == NULL))
     return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
 
   r = libusb_control_transfer
   (
@@ -548,6 +573,8 @@ HT6022_ErrorTypeDef HT6022_SetCH1IR
 
   if ((!IS_HT6022_IR (IR)) || (Device == NULL))
     return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
   r = libusb_control_transfer
   (
     Device->DeviceHandle,
@@ -583,6 +610,8 @@ HT6022_ErrorTypeDef HT6022_SetCH2IR
 
   if ((!IS_HT6022_IR (IR)) || (Device == NULL))
    return HT6022_ERROR_INVALID_PARAM;
+  if (Device->DeviceHandle == NULL)
+    return HT6022_ERROR_NO_DEVICE;
   r = libusb_control_transfer
   (
     Device->DeviceHandle,
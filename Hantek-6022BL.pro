@@ -14,22 +14,65 @@ INCLUDEPATH += /usr/include/libusb-1.0
 LIBS += -L/usr/lib
 LIBS +=-lusb-1.0
 LIBS +=-lm
+QMAKE_CFLAGS += -ftree-vectorize       # filter and math kernels are block loops
 
 SOURCES += main.cpp\
         mainwindow.cpp \
     HT6022fw.c \
     HT6022.c \
     worker.cpp \
+    device.cpp \
+    decoder.cpp \
+    session.cpp \
     qcustomplot.cpp \
+    trace.cpp \
     DSOutils.c \
+    DSOmath.c \
+    DSOfilter.c \
+    DSOaverage.c \
+    DSOmask.c \
+    DSOdecode.c \
+    DSOsettings.c \
+    DSOframe.c \
+    DSOraster.c \
+    DSOroll.c \
+    DSOlog.c \
+    DSOtrigger.c \
+    DSOsim.c \
+    DSOets.c \
+    DSOsession.c \
+    DSOref.c \
+    DSOcal.c \
+    DSOscale.c \
     PostTrig.c
 
 HEADERS  += mainwindow.h \
     HT6022fw.h \
     HT6022.h \
     worker.h \
+    device.h \
+    decoder.h \
+    session.h \
     qcustomplot.h \
+    trace.h \
     DSOutils.h \
+    DSOmath.h \
+    DSOfilter.h \
+    DSOaverage.h \
+    DSOmask.h \
+    DSOdecode.h \
+    DSOsettings.h \
+    DSOframe.h \
+    DSOraster.h \
+    DSOroll.h \
+    DSOlog.h \
+    DSOtrigger.h \
+    DSOsim.h \
+    DSOets.h \
+    DSOsession.h \
+    DSOref.h \
+    DSOcal.h \
+    DSOscale.h \
     dso.h \
     PostTrig.h
 
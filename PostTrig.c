@@ -18,15 +18,38 @@
 
 
   06/01/2018  Display of post trigger data so limited pre-trigger support
+
+  Traces are formatted in single precision from the 8 bit samples through
+  to the plot, which is more than enough for a display and halves the
+  memory written, while the compiler fits twice as many values in each
+  SIMD register.  Only the short trigger window is still upsampled and
+  scaled in double precision, from the channel's own VScale and Zero
+  rather than its float scale table, so refine_trigger() is exactly as
+  before.  Both share the one sin(x)/x kernel and loop, see RESAMPLE().
+
+  That window is now only for a filtered trigger channel, where the edge
+  on screen is the filtered one.  Otherwise time_trigger() finds the edge
+  on the raw samples with trigger_time(), by sinc where the display is
+  sin(x)/x upsampled and linearly where it joins samples with straight
+  lines, so the trigger lands where the trace drawn crosses the level.
 */
 
 #include <stdbool.h>
 #include "HT6022.h"
 #include "dso.h"
+#include "DSOmath.h"
+#include "DSOfilter.h"
+#include "DSOaverage.h"
+#include "DSOframe.h"
+#include "DSOroll.h"
+#include "DSOtrigger.h"
+#include "DSOets.h"
+#include "DSOscale.h"
 #include "PostTrig.h"
 
 
-extern DSO_SET Dso;
+static DSO_SET Set;            // timing of the frame being formatted, see below
+static double Jitter;                          // of trigger edges, s, see below
 
 #ifdef __cplusplus
  extern "C" {
@@ -34,7 +57,7 @@ extern DSO_SET Dso;
 
 #define TRIG_WIN 50
 
-static const int fir[10][5] = // convolution kernel for 5 fold sin(x)/x upsample
+static const float fir[10][5] = // kernel for 5 fold sin(x)/x upsample, exact
 {
   {      0,     626,    1432,    1942,    1579 },
   {      0,   -2556,   -5136,   -6299,   -4726 },
@@ -49,10 +72,10 @@ static const int fir[10][5] = // convolution kernel for 5 fold sin(x)/x upsample
 };
 
 
-static inline unsigned char minmax(unsigned char* ch, int j)
+static inline unsigned char minmax(const unsigned char* ch, int s, int k)
 {
   // returns alternately the minimum or maximum value within two
-  // consecutive sample intervals.
+  // consecutive sample intervals: ch is sample k of a channel of stride s.
 
   static unsigned char prev;
   unsigned char min;
@@ -60,31 +83,118 @@ static inline unsigned char minmax(unsigned char* ch, int j)
   unsigned char c;
   int i;
 
-  for(i = 0, min = 255, max = 0; i < 2 * Dso.SubSample; i += 2)
+  for(i = 0, min = 255, max = 0; i < s * Set.SubSample; i += s)
   {
     min = ch[i] < min ? ch[i] : min;
     max = ch[i] > max ? ch[i] : max;
   }
-  if((j / (2 * Dso.SubSample)) & 1) c = min < prev ? min : prev, prev = max;
+  if((k / Set.SubSample) & 1) c = min < prev ? min : prev, prev = max;
   else c = max > prev ? max : prev, prev = min;
   return c;
 }
 
 
-static int scan                // de-interleave the traces in the raw CH0 buffer
+static inline float boxcar(const unsigned char* ch, int s)
+{
+  // Hi-Res: mean of the samples in one display interval rather than just
+  // the first of them, trading bandwidth for resolution beyond 8 bits.
+
+  int32_t sum = 0;
+  int i;
+
+  for(i = 0; i < Set.SubSample; i++) sum += ch[s * i];
+  return (float)sum / Set.SubSample;
+}
+
+
+static inline float boxcarf(float* x)
+{
+  float sum = 0;
+  int i;
+
+  for(i = 0; i < Set.SubSample; i++) sum += x[i];
+  return sum / Set.SubSample;
+}
+
+
+static inline float minmaxf(float* x, int j)
+{
+  // as minmax() but for a block of filtered samples at unit stride
+
+  static float prev;
+  float min;
+  float max;
+  float c;
+  int i;
+
+  for(i = 0, min = 255, max = 0; i < Set.SubSample; i++)
+  {
+    min = x[i] < min ? x[i] : min;
+    max = x[i] > max ? x[i] : max;
+  }
+  if(j & 1) c = min < prev ? min : prev, prev = max;
+  else c = max > prev ? max : prev, prev = min;
+  return c;
+}
+
+
+static int filtered_scan        // de-interleave and filter, then as for scan()
+(
+  float* CH,                                            // output waveform trace
+  const FRAME_CHANNEL* Src,
+  int i,                                 // sample index of first output point
+  int j,                                                   // first output point
+  bool Glitch,
+  bool HiRes,
+  DSO_FILTER* Filter,
+  int SzDispBuf                                            // Display bufer size
+)
+{
+  static float x[FILTER_BLOCK];
+  int SubSample = Set.SubSample;
+  int n;
+  int k;
+
+  if(Filter->Ts != Set.Ts) filter_design(Filter, Set.Ts);    // timebase changed
+  filter_start(Filter, Src->Data, Src->Stride, i, Src->Length);
+
+  if(Glitch && !HiRes && SubSample > 1) SzDispBuf--;
+  n = FILTER_BLOCK / SubSample;    // whole display intervals in each block
+  while(j < SzDispBuf)
+  {
+    if(n > SzDispBuf - j) n = SzDispBuf - j;
+    filter_run(Filter, x, n * SubSample);
+    if(SubSample == 1)
+      for(k = 0; k < n; k++) CH[j+k] = x[k];
+    else if(HiRes)
+      for(k = 0; k < n; k++) CH[j+k] = boxcarf(x + k * SubSample);
+    else if(Glitch)
+      for(k = 0; k < n; k++) CH[j+k] = minmaxf(x + k * SubSample, j + k);
+    else
+      for(k = 0; k < n; k++) CH[j+k] = x[k * SubSample];
+    j += n;
+  }
+  return j;
+}
+
+
+static int scan            // de-interleave a trace from the raw transfer buffer
 (
-  unsigned char* CH,                                    // output waveform trace
-  unsigned char* CH0,
+  float* CH,                                            // output waveform trace
+  const FRAME_CHANNEL* Src,                   // one channel, read where it lies
   int triggerIdx,                               // initial trigger edge position
-  int channel,                                                         // 0 or 1
   bool Glitch,   // invokes minmax mode to display short pulses on slow timebase
+  bool HiRes,               // boxcar average over each display interval instead
+  DSO_FILTER* Filter,                                  // channel filter or NULL
   int SzDispBuf                                            // Display bufer size
 )
 {
-  int i;
+  const unsigned char* ch;
+  const int s = Src->Stride;
+  int k;                                     // sample index of ch, for minmax()
   int j;
   int offset = 0;
-  int SubSample = Dso.SubSample;   // number of actual samples per display point
+  int SubSample = Set.SubSample;   // number of actual samples per display point
 
   if(triggerIdx < 8)                      // triggerIdx is zero if no edge found
   {
@@ -92,70 +202,137 @@ static int scan                // de-interleave the traces in the raw CH0 buffer
     triggerIdx = 8+5;
   }
 
-  i = (triggerIdx - 8) * 2 + channel;
+  k = triggerIdx - 8;
   j = offset / SubSample;                      // possible truncation error here
 
   if(j >= SzDispBuf) return 0;
 
-  if(Dso.MemDepth - triggerIdx < SzDispBuf * SubSample)
-    SzDispBuf = (Dso.MemDepth - triggerIdx) / SubSample;
+  if(Src->Length - triggerIdx < SzDispBuf * SubSample)
+    SzDispBuf = (Src->Length - triggerIdx) / SubSample;
+
+  if(Filter && Filter->Type != FILTER_OFF)       // full rate, before decimation
+    return filtered_scan(CH,Src,k,j,Glitch,HiRes,Filter,SzDispBuf);
 
+  ch = Src->Data + k * s;
   if(SubSample == 1)                    // special case for no decimation: speed
-    for(; j < SzDispBuf; i += 2, j++) CH[j] = CH0[i];
+    for(; j < SzDispBuf; ch += s, j++) CH[j] = *ch;
+
+  else if(HiRes)                 // boxcar average: more bits on slow timebases
+    for(; j < SzDispBuf; ch += s*SubSample, j++) CH[j] = boxcar(ch, s);
 
   else if(Glitch)           // minmax mode to display sub sample interval pulses
-    for(; j < SzDispBuf-1; i += 2*SubSample, j++) CH[j] = minmax(CH0+i, i);
+    for(; j < SzDispBuf-1; ch += s*SubSample, k += SubSample, j++)
+      CH[j] = minmax(ch, s, k);
   else                                                               // decimate
-    for(; j < SzDispBuf; i += 2*SubSample, j++) CH[j] = CH0[i];
+    for(; j < SzDispBuf; ch += s*SubSample, j++) CH[j] = *ch;
   return j;     // the number of samples read: varies with trigger edge position
 }
 
 
-static void vectorise                 // scale and if necesary upsample waveform
+static inline float upsample       // point j of 5 between CH[4] and CH[5] ...
 (
-  double* y_vec,                                          // output scaled trace
-  unsigned char* CH,                                         // imput trace data
-  DSO_CHANNEL* Channel,                                    // scaling parameters
+  const float* CH,
+  int j
+)
+{
+  return                                  // ... less 5e-6 scaling, reversed
+    CH[0] * fir[0][j] +
+    CH[1] * fir[1][j] +
+    CH[2] * fir[2][j] +
+    CH[3] * fir[3][j] +
+    CH[4] * fir[4][j] +
+    CH[5] * fir[5][j] +
+    CH[6] * fir[6][j] +
+    CH[7] * fir[7][j] +
+    CH[8] * fir[8][j] +
+    CH[9] * fir[9][j];
+}
+
+
+// resample() and resample_trigger() below differ only in the type of y and
+// of VScale and VZero, float for the display and double for refine_trigger()
+
+#define RESAMPLE(y, CH, VScale, VZero, MemDepth)                              \
+  if(Set.Tdiv <= 500e-9)    /* upsample using sin(x)/x: too few data points */ \
+  {                                                                           \
+    VScale *= 5e-6;                                                           \
+    for(i = 0; i < (MemDepth - 5) / 5; i++)                                   \
+      for(j = 0; j < 5; j++)                                                  \
+        y[5 * i + 4 - j] = VZero + VScale * upsample(CH + i, j);              \
+  }                                                                           \
+  else for(i = 0; i < MemDepth; i++) y[i] = VZero + VScale * CH[i]
+
+
+static void resample              // scale and if necesary upsample a trace
+(
+  float* y_vec,                                           // output scaled trace
+  const float* CH,                                           // imput trace data
+  float VScale,                                        // display units per unit
+  float VZero,                                         // display offset
   int MemDepth                               // size of input and output buffers
 )
 {
   int i;
   int j;
+
+  RESAMPLE(y_vec, CH, VScale, VZero, MemDepth);
+}
+
+
+static void resample_trigger       // as resample() in double, for TRIG_WIN only
+(
+  double* t_vec,                                          // output scaled trace
+  const float* CH,                                           // imput trace data
+  double VScale,                                       // display units per unit
+  double VZero                                         // display offset
+)
+{
+  int i;
+  int j;
+
+  RESAMPLE(t_vec, CH, VScale, VZero, TRIG_WIN);
+}
+
+
+static void vectorise                 // scale and if necesary upsample waveform
+(
+  float* y_vec,                                           // output scaled trace
+  float* CH,                                                 // imput trace data
+  DSO_CHANNEL* Channel,                                    // scaling parameters
+  int MemDepth                               // size of input and output buffers
+)
+{
+  const DSO_SCALE* s = Channel->Scale;           // as its table, see DSOscale.c
+
+  resample(y_vec, CH, s->ScreenStep, s->ScreenZero, MemDepth);
+}
+
+
+static void vectorise_trigger         // trigger window for refine_trigger() ...
+(
+  double* t_vec,
+  float* CH,
+  DSO_CHANNEL* Channel
+)
+{
   double VScale, VZero;
 
-  VScale =  Channel->VScale / (128 * 4 * Channel->Vdiv);
-  if(Channel->Inv && MemDepth != TRIG_WIN) VScale = -VScale; // positive trigger
+  VScale =  Channel->VScale / (128 * 4 * Channel->Vdiv);     // ... not inverted
   VZero = Channel->VOffset - (Channel->Zero + 128) * VScale;
 
-  if(Dso.Tdiv <= 500e-9)       // Upsample using sin(x)/x as too few data points
-  {
-    VScale *= 5e-6;
-
-    for(i = 0; i < (MemDepth - 5) / 5; i++)
-    {
-      for(j = 0; j < 5; j++)
-      {
-        y_vec[5 * i + 4 - j] = VZero + VScale *
-        (
-          CH[i+0] * fir[0][j] +
-          CH[i+1] * fir[1][j] +
-          CH[i+2] * fir[2][j] +
-          CH[i+3] * fir[3][j] +
-          CH[i+4] * fir[4][j] +
-          CH[i+5] * fir[5][j] +
-          CH[i+6] * fir[6][j] +
-          CH[i+7] * fir[7][j] +
-          CH[i+8] * fir[8][j] +
-          CH[i+9] * fir[9][j]
-        );
-      }
-    }
-  }
-  else
-  {
-    for(i = 0; i < MemDepth; i++)
-      y_vec[i] = VZero + VScale * CH[i];
-  }
+  resample_trigger(t_vec, CH, VScale, VZero);
+}
+
+
+static void vectorise_math       // scale and if necessary upsample math trace
+(
+  float* y_vec,                                           // output scaled trace
+  float* M,                                            // input trace in volts
+  DSO_MATH* Math,                                          // scaling parameters
+  int MemDepth                               // size of input and output buffers
+)
+{
+  resample(y_vec, M, 1.0 / (4 * Math->Vdiv), Math->VOffset, MemDepth);
 }
 
 
@@ -169,10 +346,10 @@ static double refine_trigger      // fine trigger adjustment using interpolation
   int i;
   double tl;                                                     //trigger level
 
-  tl = Dso.VTrigger/(4*Channel->Vdiv)+Channel->VOffset;
+  tl = Set.VTrigger/(4*Channel->Vdiv)+Channel->VOffset;
 
-  if(Dso.Tdiv <= 500e-9) i = 16;                              // trace upsampled
-  else i = 8 / Dso.SubSample;
+  if(Set.Tdiv <= 500e-9) i = 16;                              // trace upsampled
+  else i = 8 / Set.SubSample;
 
   if(TriggerEdge)                                                 // rising edge
   {
@@ -190,88 +367,238 @@ static double refine_trigger      // fine trigger adjustment using interpolation
 }
 
 
+static bool time_trigger         // fine trigger adjustment from the raw samples
+(
+  double* tp,                                        // as from refine_trigger()
+  const FRAME_CHANNEL* Src,                                   // trigger channel
+  int TriggerPoint,                      // sample just before edge, from worker
+  int triggerIdx,                              // first sample of the traces + 8
+  DSO_CHANNEL* Channel,
+  int TriggerEdge
+)
+{
+  static TRIGGER_TIME Timing;                     // jitter over recent captures
+  double level;
+  double x;
+
+  if(Channel->Filter && Channel->Filter->Type != FILTER_OFF) return false;
+
+  level = scale_code(Channel->Scale, Set.VTrigger);
+  if
+  (
+    !trigger_time
+    (
+      &Timing, Src->Data, Src->Stride, Src->Length, TriggerPoint + 1,
+      TriggerEdge, level, Set.Tdiv <= 500e-9 ? TRIGGER_SINC : TRIGGER_LINEAR
+    )
+  ) return false;
+
+  x = Timing.Crossing - (triggerIdx - 8);           // from first sample scanned
+  if(Set.Tdiv <= 500e-9) *tp = 5 * x - 21;    // point 5 * i + 4 is sample i + 5
+  else *tp = x / Set.SubSample;
+  Jitter = Timing.Jitter * Set.Ts;
+  return true;
+}
+
+
+double get_trigger_jitter(void)         // rms, s: zero until edges can be timed
+{
+  return Jitter;
+}
+
+
+static void span(DSO_AXIS* Axis, int First, int End, double t0)
+{
+  if(First >= End || Axis->Spans == DSO_SPANS) return;    // oldest just dropped
+  Axis->Span[Axis->Spans].First = First;
+  Axis->Span[Axis->Spans].End = End;
+  Axis->Span[Axis->Spans].t0 = t0;
+  Axis->Spans++;
+}
+
+
+static void axis_update            // points First to End - 1 now at t0 + i * dt
+(
+  DSO_AXIS* Axis,
+  int First,
+  int End,
+  double t0,
+  double dt
+)
+{
+  DSO_AXIS Old = *Axis;
+  int f;
+  int e;
+  int s;
+
+  if(First >= End) return;                                // nothing new to show
+  if(dt != Old.dt) Old.Spans = 0;               // earlier scans now meaningless
+  Axis->dt = dt;
+  Axis->Spans = 0;
+  span(Axis, First, End, t0);
+  for(s = 0; s < Old.Spans; s++)    // what is left of earlier scans either side
+  {
+    f = Old.Span[s].First;
+    e = Old.Span[s].End;
+    span(Axis, f, e < First ? e : First, Old.Span[s].t0);
+    span(Axis, f > End ? f : End, e, Old.Span[s].t0);
+  }
+}
+
+
+void axis_clear(DSO_AXIS* Axis)                   // no trace points have a time
+{
+  Axis->Spans = 0;
+}
+
+
 int get_post_trigger_waveforms    // Read and format waveform traces from worker
 (
-  double* y1_vec,                                     // QVector<double> &y1_vec
-  double* y2_vec,                                     // QVector<double> &y2_vec
-  double* x_vec,                                       // QVector<double> &x_vec
-  unsigned char* CH0,                          // interleaved waveforms from USB
+  float* y1_vec,                                       // QVector<float> &y1_vec
+  float* y2_vec,                                       // QVector<float> &y2_vec
+  DSO_AXIS* Axis,                           // times of points, shared by traces
+  float* m1_vec,                                     // math trace display data
+  float* m2_vec,
+  const DSO_FRAME* Frame,                   // waveforms as read, held by caller
+  const DSO_SET* View,                  // timing for Frame, see settings_view()
   DSO_CHANNEL* Channel1,
   DSO_CHANNEL* Channel2,
-  int TriggerPoint,                             // initial trigger edge position
-  int TriggerEdge                                           // rising or falling
+  DSO_MATH* Math                                      // MATH_TRACES expressions
 )
 {
-  static unsigned char CH1[HT6022_1KB];
-  static unsigned char CH2[HT6022_1KB];
+  static float CH1[HT6022_1KB];            // codes, fractional once filtered
+  static float CH2[HT6022_1KB];
+  static float M1[HT6022_1KB];                      // math traces, in volts
+  static float M2[HT6022_1KB];
+  static float* M[MATH_TRACES] = {M1, M2};
 
-  static unsigned char CH3[TRIG_WIN+8];
+  static float CH3[TRIG_WIN+8];
   static double t_vec[TRIG_WIN];        //static QVector<double>t_vec(TRIG_WIN);
 
   static double tp;                                             // trigger point
 
+  const int TriggerPoint = Frame->TriggerPoint;          // initial trigger edge
+  DSO_CHANNEL* Trigger;                                       // trigger channel
+  bool timed = false;                           // tp found from the raw samples
+  FRAME_CHANNEL Src[2];                          // both channels, read in place
+  float* A1;                                  // traces, averaged if selected
+  float* A2;
   int i;
   int triggerIdx;              // trigger edge position (may be offset by delay)
   int DataSize;             // number of samples actually read into trace buffer
   double Ts;
 
+  Set = *View;                 // one consistent set for the whole of this frame
+  Src[0] = frame_channel(Frame, 0);
+  Src[1] = frame_channel(Frame, 1);
+  Trigger = Set.ChTrigger == 1 ? Channel1 : Channel2;
   triggerIdx = TriggerPoint;
 
   if(triggerIdx < 8) triggerIdx = 8;     // prevent out of bounds read in scan()
 
-  if(Dso.TriggerDelay + triggerIdx > Dso.MemDepth) return -1;  // delay > buffer
+  if(Set.TriggerDelay + triggerIdx > Set.MemDepth) return -1;  // delay > buffer
 
-  if(TriggerPoint)                // copy trigger edge for subsequent refinement
-    scan(CH3,CH0,triggerIdx,Dso.ChTrigger==1?0:1,false,TRIG_WIN+8);
+  if(TriggerPoint)                       // time the edge as read where possible
+    timed = time_trigger
+    (
+      &tp, &Src[Set.ChTrigger==1?0:1], TriggerPoint, triggerIdx, Trigger,
+      Frame->Settings.TriggerEdge
+    );
 
-  triggerIdx += Dso.TriggerDelay;                              //delayed trigger
+  if(TriggerPoint && !timed)      // copy trigger edge for subsequent refinement
+    scan
+    (
+      CH3,&Src[Set.ChTrigger==1?0:1],triggerIdx,false,false,
+      Trigger->Filter,TRIG_WIN+8
+    );
 
-  DataSize = HT6022_1KB;                          // default value for AUTO mode
+  triggerIdx += Set.TriggerDelay;                              //delayed trigger
 
-                            // Copy data from acquisition buffer to free this up
-  if((Channel1->Enabled || Dso.ChAdd == 2) && (TriggerPoint||Dso.Mode==AUTO))
-    DataSize = scan(CH1,CH0,triggerIdx,0,Channel1->Glitch,HT6022_1KB);
+  DataSize = HT6022_1KB;                          // default value for AUTO mode
 
-  if((Channel2->Enabled || Dso.ChAdd == 1) && (TriggerPoint||Dso.Mode==AUTO))
-    DataSize = scan(CH2,CH0,triggerIdx,1,Channel2->Glitch,HT6022_1KB);
+                       // decimate straight from the frame's transfer buffer
+  if((Channel1->Enabled || Set.ChAdd == 2) && (TriggerPoint||Set.Mode==AUTO))
+    DataSize = scan
+    (
+      CH1,&Src[0],triggerIdx,Channel1->Glitch,Channel1->HiRes,Channel1->Filter,
+      HT6022_1KB
+    );
+
+  if((Channel2->Enabled || Set.ChAdd == 1) && (TriggerPoint||Set.Mode==AUTO))
+    DataSize = scan
+    (
+      CH2,&Src[1],triggerIdx,Channel2->Glitch,Channel2->HiRes,Channel2->Filter,
+      HT6022_1KB
+    );
+
+                                        // full rate, both math traces at once
+  if((Math[0].Enabled || Math[1].Enabled) && (TriggerPoint||Set.Mode==AUTO))
+    DataSize = math_scan
+    (
+      M,&Src[0],&Src[1],triggerIdx,Math,Channel1,Channel2,&Set,HT6022_1KB
+    );
 
   // As CH1 and CH2 are not cleared between display updates, we see a composite
   // of a number of scans.  This is useful at 2us/div and below where the
   // actual trigger point may occur well into the 1K sample buffer if it occurs
   // at all.  Note that changing TriggerDelay invalidates the corespondence
-  // between the timing vectors in x_vec and the contents of CH0 and CH1.
+  // between the spans of Axis and the contents of CH1 and CH2.
 
-  if(Channel1->Enabled || Dso.ChAdd == 2)
-    vectorise(y1_vec, CH1, Channel1, Dso.DisplayDepth);
+  // Averaging only accumulates triggered acquisitions, each once, but
+  // continues to show the average while AUTO free runs without a trigger.
 
-  if(Channel2->Enabled || Dso.ChAdd == 1)
-    vectorise(y2_vec, CH2, Channel2, Dso.DisplayDepth);
+  A1 = CH1;
+  if(Channel1->Average->Type != AVERAGE_OFF)
+  {
+    if(TriggerPoint)
+      A1 = average_update
+        (Channel1->Average, CH1, Frame->Sequence, HT6022_1KB);
+    else if(Channel1->Average->Count) A1 = Channel1->Average->Out;
+  }
+
+  A2 = CH2;
+  if(Channel2->Average->Type != AVERAGE_OFF)
+  {
+    if(TriggerPoint)
+      A2 = average_update
+        (Channel2->Average, CH2, Frame->Sequence, HT6022_1KB);
+    else if(Channel2->Average->Count) A2 = Channel2->Average->Out;
+  }
 
-  if(Dso.ChAdd == 1)
+  if(Channel1->Enabled || Set.ChAdd == 2)
+    vectorise(y1_vec, A1, Channel1, Set.DisplayDepth);
+
+  if(Channel2->Enabled || Set.ChAdd == 1)
+    vectorise(y2_vec, A2, Channel2, Set.DisplayDepth);
+
+  if(Set.ChAdd == 1)
     for(i = 0; i < HT6022_1KB; i++) y1_vec[i] += y2_vec[i] - Channel2->VOffset;
 
-  if(TriggerPoint)
+  if(Math[0].Enabled) vectorise_math(m1_vec, M1, &Math[0], Set.DisplayDepth);
+  if(Math[1].Enabled) vectorise_math(m2_vec, M2, &Math[1], Set.DisplayDepth);
+
+  if(TriggerPoint && !timed)
   {                                     // refine trigger; about 24 for sin(x)/x
-    vectorise(t_vec, CH3, Dso.ChTrigger==1?Channel1:Channel2, TRIG_WIN);
-    tp = refine_trigger(t_vec, TriggerEdge, Dso.ChTrigger==1?Channel1:Channel2);
+    vectorise_trigger(t_vec, CH3, Trigger);
+    tp = refine_trigger(t_vec, Frame->Settings.TriggerEdge, Trigger);
   }
-  else if((Dso.Mode == AUTO && Dso.Status == RUN))// || Dso.Status == STOP)
+  else if(TriggerPoint == 0 && (Set.Mode == AUTO && Set.Status == RUN))
   {
-    tp = 1 + 8 / Dso.SubSample;               // default position if no trigger
+    tp = 1 + 8 / Set.SubSample;                // default position if no trigger
   }
 
-  if(triggerIdx < 8) i = (8+5 - triggerIdx) / Dso.SubSample; //1st 5 samples bad
+  if(triggerIdx < 8) i = (8+5 - triggerIdx) / Set.SubSample; //1st 5 samples bad
   else i = 0;
 
-  if(Dso.Tdiv <= 500e-9)
-    i *= 5, Ts = Dso.Ts * Dso.SubSample / 5, DataSize *= 5;
+  if(Set.Tdiv <= 500e-9)
+    i *= 5, Ts = Set.Ts * Set.SubSample / 5, DataSize *= 5;
   else
-    Ts = Dso.Ts * Dso.SubSample;
+    Ts = Set.Ts * Set.SubSample;
 
   DataSize = DataSize > HT6022_1KB ? HT6022_1KB : DataSize;
 
-  for(; i < DataSize; i++) x_vec[i]=(i-tp)*Ts-Dso.TriggerOffset;//reposition
-  // At 2us/div and below, x_vec can be a composite of several fractional
+  axis_update(Axis, i, DataSize, -tp * Ts - Set.TriggerOffset, Ts);//reposition
+  // At 2us/div and below, Axis can be a composite of several fractional
   // timing offsets.  This is necessary to allow the various sub traces to line
   // up correctly on screen.
 
@@ -279,6 +606,125 @@ int get_post_trigger_waveforms    // Read and format waveform traces from worker
 }
 
 
+int get_unit_waveforms           // traces from a further 'scope for merged view
+(
+  float* y1_vec,
+  float* y2_vec,
+  const DSO_FRAME* Frame,           // from that unit, with its own trigger edge
+  const DSO_SET* View,                                  // timing for that Frame
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
+)
+{
+  static float CH1[HT6022_1KB];
+  static float CH2[HT6022_1KB];
+
+  const int TriggerPoint = Frame->TriggerPoint;
+  FRAME_CHANNEL Src[2];
+  int triggerIdx;
+
+  // Each unit triggers on its own data with the same trigger settings, so
+  // aligning on its trigger edge lines it up with x_vec of the first unit.
+  // Filters, averaging and math only apply to the first unit.
+
+  Set = *View;
+  Src[0] = frame_channel(Frame, 0);
+  Src[1] = frame_channel(Frame, 1);
+  triggerIdx = TriggerPoint < 8 ? 8 : TriggerPoint;
+  if(Set.TriggerDelay + triggerIdx > Set.MemDepth) return -1;
+  triggerIdx += Set.TriggerDelay;
+
+  if(Channel1->Enabled)
+  {
+    scan
+    (
+      CH1,&Src[0],triggerIdx,Channel1->Glitch,Channel1->HiRes,NULL,HT6022_1KB
+    );
+    vectorise(y1_vec, CH1, Channel1, Set.DisplayDepth);
+  }
+
+  if(Channel2->Enabled)
+  {
+    scan
+    (
+      CH2,&Src[1],triggerIdx,Channel2->Glitch,Channel2->HiRes,NULL,HT6022_1KB
+    );
+    vectorise(y2_vec, CH2, Channel2, Set.DisplayDepth);
+  }
+
+  return TriggerPoint;
+}
+
+
+int get_roll_waveforms      // strip chart so far, newest at the right hand edge
+(
+  float* y1_vec,
+  float* y2_vec,
+  DSO_AXIS* Axis,
+  const DSO_ROLL* Roll,                  // as streamed by a worker, held locked
+  const DSO_SET* View,
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
+)
+{
+  static float CH[HT6022_1KB];
+  double dt;
+  int n = 0;
+
+  // Each column is shown as its minimum and maximum, as in Glitch mode, so
+  // nothing between samples is lost however slow the timebase.  Filters,
+  // averaging and math need the full rate samples and do not apply.
+
+  Set = *View;
+  if(Channel1->Enabled)
+  {
+    n = roll_trace(Roll, 0, CH);
+    vectorise(y1_vec, CH, Channel1, n);
+  }
+  if(Channel2->Enabled)
+  {
+    n = roll_trace(Roll, 1, CH);
+    vectorise(y2_vec, CH, Channel2, n);
+  }
+
+  dt = Roll->Decimate * Set.Ts / 2;
+  axis_clear(Axis);                                   // scrolls, not composited
+  axis_update(Axis, 0, n, 10 * Set.Tdiv - (n - 1) * dt, dt);
+  return n;
+}
+
+
+int get_ets_waveforms           // equivalent time picture, 0 until there is one
+(
+  float* y1_vec,
+  float* y2_vec,
+  DSO_AXIS* Axis,
+  const DSO_ETS* Ets,                      // as binned by a worker, held locked
+  const DSO_SET* View,
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
+)
+{
+  static float CH[ETS_BINS];
+  int n = 0;
+
+  // Bins are already far closer than sin(x)/x upsampling would put the
+  // points, so they are scaled as they are.  Filters, averaging and math
+  // work on single acquisitions and do not apply.
+
+  Set = *View;
+  Set.Tdiv = 1;                                         // scale, never upsample
+  if(Channel1->Enabled && (n = ets_trace(Ets, 0, CH)))
+    vectorise(y1_vec, CH, Channel1, n);
+  if(Channel2->Enabled && (n = ets_trace(Ets, 1, CH)))
+    vectorise(y2_vec, CH, Channel2, n);
+  if(!n) return 0;
+
+  axis_clear(Axis);                        // one grid, not a composite of scans
+  axis_update(Axis, 0, n, 0, Ets->dt);
+  return n;
+}
+
 #ifdef __cplusplus
     }
 #endif
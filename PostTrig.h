@@ -27,14 +27,47 @@
 
 extern int get_post_trigger_waveforms
 (
-  double* y1_vec,                                    // QVector<double> &y1_vec,
-  double* y2_vec,                                    // QVector<double> &y2_vec,
-  double* x_vec,                                      // QVector<double> &x_vec,
-  unsigned char* CH0,                          // interleaved waveforms from USB
+  float* y1_vec,                                      // QVector<float> &y1_vec,
+  float* y2_vec,                                      // QVector<float> &y2_vec,
+  DSO_AXIS* Axis,                                   // times of points in traces
+  float* m1_vec,                                     // math trace display data
+  float* m2_vec,
+  const DSO_FRAME* Frame,                   // waveforms as read, held by caller
+  const DSO_SET* View,                  // timing for Frame, see settings_view()
   DSO_CHANNEL* Channel1,
   DSO_CHANNEL* Channel2,
-  int TriggerPoint,                             // initial trigger edge position
-  int TriggerEdge                                           // rising or falling
+  DSO_MATH* Math                                      // MATH_TRACES expressions
+);
+extern void axis_clear(DSO_AXIS* Axis);
+extern double get_trigger_jitter(void);
+extern int get_roll_waveforms
+(
+  float* y1_vec,
+  float* y2_vec,
+  DSO_AXIS* Axis,
+  const DSO_ROLL* Roll,                  // as streamed by a worker, held locked
+  const DSO_SET* View,
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
+);
+extern int get_ets_waveforms
+(
+  float* y1_vec,
+  float* y2_vec,
+  DSO_AXIS* Axis,
+  const DSO_ETS* Ets,                      // as binned by a worker, held locked
+  const DSO_SET* View,
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
+);
+extern int get_unit_waveforms
+(
+  float* y1_vec,
+  float* y2_vec,
+  const DSO_FRAME* Frame,           // from that unit, with its own trigger edge
+  const DSO_SET* View,                                  // timing for that Frame
+  DSO_CHANNEL* Channel1,
+  DSO_CHANNEL* Channel2
 );
 
 #ifdef __cplusplus
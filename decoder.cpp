@@ -0,0 +1,66 @@
+/*
+  decoder.cpp: Background serial protocol decoding thread.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Thresholding is done by the caller while it still owns the acquisition
+  buffer, which takes a couple of milliseconds for 1MB; the decoders then
+  work through the packed bit streams here a chunk at a time, signalling
+  after each chunk so annotations appear while a long capture is decoded.
+  In roll mode the worker submits each transfer as more of the same
+  stream, which starts afresh once its bits or annotations are full.
+*/
+
+
+#include "decoder.h"
+
+
+void decoderThread::submit
+(
+  const unsigned char* CH0,                    // interleaved waveforms from USB
+  int first,                                   // first sample to threshold
+  int n,                                               // samples per channel
+  bool restart                           // new capture rather than more data
+)
+{
+  lock.lock();
+  if
+  (
+    restart || Decode.Length + n > HT6022_1MB ||
+    Decode.Annotations == DECODE_MAX
+  ) decode_reset(&Decode);
+  decode_threshold(&Decode, CH0, first, n);
+  more = true;
+  pending.wakeOne();
+  lock.unlock();
+}
+
+
+void decoderThread::run()
+{
+  bool done;
+
+  while(alive)
+  {
+    lock.lock();
+    if(!more) pending.wait(&lock, 100);      // wake regularly to check alive
+    done = !more;
+    if(more) more = decode_run(&Decode, DECODE_CHUNK);
+    lock.unlock();
+    if(!done) emit decoded();
+  }
+}
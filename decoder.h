@@ -0,0 +1,49 @@
+/*
+  decoder.h
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DECODER_H
+#define DECODER_H
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include "DSOdecode.h"
+
+class decoderThread : public QThread
+{
+    Q_OBJECT
+public:
+    QMutex lock;              // hold while reading Decode from another thread
+    int alive;                                         // for thread termination
+    void submit                         // threshold now, decode in background
+    (
+      const unsigned char* CH0,
+      int first,
+      int n,
+      bool restart                       // new capture rather than more data
+    );
+signals:
+    void decoded();                           // more annotations are available
+private:
+    QWaitCondition pending;
+    bool more;                               // undecoded samples in bit streams
+    void run();
+};
+
+#endif                                                              // DECODER_H
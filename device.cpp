@@ -0,0 +1,133 @@
+/*
+  device.cpp: Background USB device manager: firmware upload, open and
+  reconnect as the 'scope is plugged in and out.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  The bare 6022 enumerates as 04B4:602A and, once its firmware has been
+  loaded, re-enumerates as 04B5:602A.  libusb hotplug callbacks run on this
+  thread from libusb_handle_events and must not do synchronous I/O, so they
+  only set flags which the loop below acts on.  Where hotplug is not
+  supported the loop falls back to polling once a second.
+
+  Up to DSO_UNITS 'scopes are opened, each handed to the GUI thread which
+  gives it to a free acquisition thread, swapping it in under that thread's
+  DeviceLock.  HT6022_DeviceOpen skips devices that are already open.
+*/
+
+
+#include "device.h"
+#include "HT6022fw.h"
+
+#define HT6022_VENDOR_ID 0x04B5                       // after firmware load
+#define HT6022_MODEL     0x602A
+
+
+static int LIBUSB_CALL hotplug
+(
+  libusb_context* ctx,
+  libusb_device* dev,
+  libusb_hotplug_event event,
+  void* user
+)
+{
+  deviceThread* thread = (deviceThread*)user;
+  struct libusb_device_descriptor desc;
+
+  (void)ctx;
+  if(libusb_get_device_descriptor(dev, &desc) != 0) return 0;
+
+  if(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+  {
+    if(desc.idVendor == HT6022_FIRMWARE_VENDOR_ID) thread->upload++;
+    else if(desc.idVendor == HT6022_VENDOR_ID) thread->open = true;
+  }
+  else if(desc.idVendor == HT6022_VENDOR_ID)
+    thread->left[libusb_get_device_address(dev)] = true;
+  return 0;                                             // stay registered
+}
+
+
+void deviceThread::run()
+{
+  libusb_hotplug_callback_handle handle;
+  HT6022_DeviceTypeDef Found;
+  struct timeval tv = {0, 100000};                    // 100ms event timeout
+  bool polled;
+  int n;                                          // opened on this pass
+  int tries = 0;                               // attempts since an arrival
+  int i;
+
+  upload = 0;
+  open = false;
+  for(i = 0; i < 256; i++) left[i] = false;
+  polled =
+    !libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) ||
+    libusb_hotplug_register_callback
+    (
+      NULL,
+      (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+        LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+      LIBUSB_HOTPLUG_ENUMERATE,                 // devices already present too
+      LIBUSB_HOTPLUG_MATCH_ANY,
+      HT6022_MODEL,
+      LIBUSB_HOTPLUG_MATCH_ANY,
+      hotplug,
+      this,
+      &handle
+    ) != LIBUSB_SUCCESS;
+
+  while(alive)
+  {
+    if(polled && units < DSO_UNITS) upload = 1, open = true;
+
+    if(upload)                                    // one 'scope per pass ...
+    {
+      upload--;
+      if(HT6022_FirmwareUpload() == HT6022_SUCCESS)       // ... re-enumerates
+      {
+        emit status("Loading Firmware...");
+        if(upload) msleep(500);         // let it go before loading the next
+      }
+    }
+
+    for(n = 0; open && units + n < DSO_UNITS;)       // ... and arrives ...
+    {
+      if(HT6022_DeviceOpen(&Found) != HT6022_SUCCESS)     // ... as 04B5:602A
+      {
+        if(n || polled || ++tries > 20) open = false, tries = 0;
+        else msleep(100);                   // not ready yet, try again soon
+        break;
+      }
+      n++;
+      tries = 0;
+      emit arrived(Found);              // GUI closes it again if it has no room
+    }
+
+    for(i = 0; i < 256; i++)
+      if(left[i])
+      {
+        left[i] = false;
+        emit lost(i);
+      }
+
+    if(polled) msleep(1000);
+    else libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+  }
+
+  if(!polled) libusb_hotplug_deregister_callback(NULL, handle);
+}
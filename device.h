@@ -0,0 +1,47 @@
+/*
+  device.h
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DEVICE_H
+#define DEVICE_H
+#include <QThread>
+#include <QMetaType>
+#include "HT6022.h"
+#include "dso.h"
+
+class deviceThread : public QThread
+{
+    Q_OBJECT
+public:
+    int alive;                                         // for thread termination
+    volatile int units;                // 'scopes in use, only written by GUI
+    int upload;                 // bare 'scopes, counted by hotplug callback ...
+    bool open;                             // ... run on this thread's events
+    bool left[256];                                    // by USB device address
+signals:
+    void arrived(HT6022_DeviceTypeDef Found);         // open and claimed here
+    void lost(int address);                           // unplugged, by address
+    void status(const QString &msg);
+private:
+    void run();
+};
+
+Q_DECLARE_METATYPE(HT6022_DeviceTypeDef)
+
+#endif                                                               // DEVICE_H
@@ -22,6 +22,8 @@
 
 #include "HT6022.h"
 
+#define DSO_UNITS 4                       // 'scopes acquired at the same time
+#define DSO_SPANS 8                      // composite of scans on fast timebases
 
 typedef enum DSO_TDIV
 {
@@ -45,7 +47,16 @@ typedef enum DSO_TDIV
   TDIV_10MS,
   TDIV_20MS,
   TDIV_50MS,
-  TDIV_100MS
+  TDIV_100MS,
+  TDIV_200MS,                               // slower than this: roll mode only
+  TDIV_500MS,
+  TDIV_1S,
+  TDIV_2S,
+  TDIV_5S,
+  TDIV_10S,
+  TDIV_20S,
+  TDIV_50S,
+  TDIV_100S
 } DSO_TDIV;
 
 typedef enum
@@ -89,6 +100,22 @@ typedef struct DSO_SET
   double TriggerOffset; // offset between trigger delay display and sampled data
 } DSO_SET;
 
+typedef struct DSO_AXIS                     // time of each trace point, implied
+{
+  double dt;                                     // seconds from one to the next
+  int Spans;                                             // in use, newest first
+  struct
+  {
+    int First;                                         // trace points First ...
+    int End;                                        // ... to End - 1 are at ...
+    double t0;                                        // ... t0 + i * dt seconds
+  } Span[DSO_SPANS];                        // parts of successive scans on show
+} DSO_AXIS;
+
+struct DSO_FILTER;
+struct DSO_AVERAGE;
+struct DSO_SCALE;
+
 typedef struct DSO_CHANNEL
 {
   double VScale;
@@ -100,6 +127,10 @@ typedef struct DSO_CHANNEL
   bool Enabled;
   bool Inv;
   bool Glitch;
+  bool HiRes;                           // boxcar rather than stride decimation
+  struct DSO_FILTER* Filter;                      // applied before decimation
+  struct DSO_AVERAGE* Average;                 // across triggered acquisitions
+  struct DSO_SCALE* Scale;                     // codes to volts, see DSOscale.c
 } DSO_CHANNEL;
 
 
@@ -26,13 +26,32 @@
 #include "DSOutils.h"
 #include "HT6022.h"
 #include "worker.h"
+#include "decoder.h"
+#include "session.h"
+#include "device.h"
 #include "dso.h"
+#include "DSOmath.h"
+#include "DSOfilter.h"
+#include "DSOaverage.h"
+#include "DSOmask.h"
+#include "DSOdecode.h"
+#include "DSOsettings.h"
+#include "DSOlog.h"
+#include "DSOsim.h"
+#include "DSOsession.h"
+#include "DSOref.h"
+#include "DSOcal.h"
+#include "DSOscale.h"
 #include "PostTrig.h"
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
-#include <float.h>
 #include <QDebug>
 #include <QElapsedTimer>
+#include <QTimer>
+#include <QInputDialog>
+#include <QFileDialog>
+#include <QFileInfo>
 
 
 
@@ -44,27 +63,65 @@ typedef enum                       // operating modes for vertical dial controls
 
 
 workerThread worker;                    // backgound waveform acquisition thread
+workerThread aux[DSO_UNITS - 1];      // further 'scopes, shown in merged view
+workerThread* Unit[DSO_UNITS];                           // worker, then aux[]
+DSO_FRAME* Shown[DSO_UNITS];              // frame on screen from each, retained
+FRAME_POOL_STATS Buffers[DSO_UNITS];         // as last shown, see ShowBuffers()
+decoderThread decoder;                  // serial protocol decode of captures
+deviceThread device;                          // USB hotplug and firmware load
+sessionThread session;                // saves settings, and capture, as changed
 DSO_SET Dso = {STOP,AUTO,1,0,0,1,HT6022_1KB,HT6022_1KB,0,1/16e6,1e-3,0,0};
                                                               // timing and mode
+DSO_SETTINGS Setup;           // as Dso, plus trigger and holdoff: see Publish()
 
 
 HT6022_DeviceTypeDef Device;                 // USB identifier for Hantek 'scope
+HT6022_DeviceTypeDef AuxDevice[DSO_UNITS - 1];
 DSO_CHANNEL Channel1, Channel2;          // current vertical deflection settings
 VARMODE_TypeDef VarCH1 = POSITION;       // vertical dial mode: POSITION or GAIN
 VARMODE_TypeDef VarCH2 = POSITION;
 QElapsedTimer timer;                  // only needed during test and development
+QElapsedTimer Startup;                    // application start to first frame
+QElapsedTimer Switch;                  // SR or IR change to first frame with it
+bool Switching = false;                              // change not yet on screen
+bool FirstFrame = false;           // report first display update from device
+unsigned int ArrivalFrame;                   // worker.Frame as device arrived
+qint64 OpenTime;                       // ms from start to the device being open
+qint64 RestoreTime = -1;                // ms to restore the session, -1 if none
+SESSION Saved;                           // as last submitted, see SaveSession()
+SESSION Restoring;               // capture still to be read, see RestoreCapture
+DSO_FRAME Restored;                        // capture on screen at last exit ...
+unsigned char RestoredData[2 * HT6022_1MB];       // ... not touched unless used
 double CursorX1 = 0;                 // timing position of vertical trigger line
 QCPItemLine* vCursorX1;                                 // vertical trigger line
 QCPItemLine* vCursorTrigger;                          // horizontal trigger line
-QVector<double> x_vec(HT6022_1KB);              // timings for each y_vec sample
-
-QVector<double>y1_vec(HT6022_1KB);
-QVector<double>y2_vec(HT6022_1KB);
+traceGraph* vTrace[2 + 2 * DSO_UNITS];     // CH1, CH2, math 1, 2, then aux[]
+QCPCurve* vMask[MASK_POLYGONS];                  // mask regions or band edges
+QCPItemText* vDecode[DECODE_SHOWN];              // protocol decode annotations
+traceGraph* vRef[2 * REF_SLOTS];                      // CH1 and CH2 of each REF
+DSO_REF Ref[REF_SLOTS];                               // REF1 to REF4, as mapped
+DSO_AXIS RefAxis[2 * REF_SLOTS];                   // each on its own timing ...
+QVector<float>r_vec[2 * REF_SLOTS];                        // ... see ShowRefs()
+DSO_AXIS Axis;                          // timings for each y_vec sample
+
+QVector<float>y1_vec(HT6022_1KB);
+QVector<float>y2_vec(HT6022_1KB);
+QVector<float>m1_vec(HT6022_1KB);                         // math trace display
+QVector<float>m2_vec(HT6022_1KB);
+QVector<float>a_vec[2 * (DSO_UNITS - 1)];          // aux units' CH1 and CH2
 int withhold = 0;              // delay switching to AUTO mode as for CRT 'scope
-int Calibrate = 0;               // set to 25 to initiate ofset null calibration
-
-
-ComboSampleTypeDef ComboSample[22] = //max buffer sizes for fast display refresh
+DSO_CAL Cal;                        // offset and gain of each range and channel
+DSO_CAL_RUN CalRun;                          // see StartCal() and Calibration()
+bool Calibrating = false;
+DSO_MODE_TypeDef CalMode;                         // Dso.Mode to return to after
+DSO_CAL AuxCal[DSO_UNITS - 1];          // further units' own, from their EEPROM
+bool AuxOwnCal[DSO_UNITS - 1];                 // else they are corrected by Cal
+DSO_CHANNEL AuxChannel[DSO_UNITS - 1][2];         // Channel1 and 2 as each sees
+DSO_SCALE AuxScale[DSO_UNITS - 1][2];
+double LogInterval = 1;                             // seconds per logged record
+
+
+ComboSampleTypeDef ComboSample[TDIV_100S + 1] = // max buffers for fast refresh
 {
   {HT6022_48MSa,  20e-9,  1/48e6,    1,   HT6022_1KB},
   {HT6022_48MSa,  50e-9,  1/48e6,    1,   HT6022_1KB},
@@ -86,7 +143,16 @@ ComboSampleTypeDef ComboSample[22] = //max buffer sizes for fast display refresh
   {HT6022_8MSa,   10e-3,0.125e-6, 1024,   HT6022_1MB}, // 128ms ack 0.1s display
   {HT6022_4MSa,   20e-3, 0.25e-6, 1024,   HT6022_1MB}, // 256ms ack,0.2s display
   {HT6022_1MSa,   50e-3,    1e-6,  625,   HT6022_1MB}, //    1s ack,0.5s display
-  {HT6022_1MSa,  100e-3,    1e-6, 1024,   HT6022_1MB}  //    1s ack,1.0s display
+  {HT6022_1MSa,  100e-3,    1e-6, 1024,   HT6022_1MB}, //    1s ack,1.0s display
+  {HT6022_500KSa,200e-3,    2e-6, 1024,   HT6022_1MB}, // roll: see DSOroll.c
+  {HT6022_200KSa,500e-3,    5e-6, 1024,   HT6022_1MB},
+  {HT6022_100KSa,     1,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,     2,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,     5,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,    10,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,    20,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,    50,    1e-5, 1024,   HT6022_1MB},
+  {HT6022_100KSa,   100,    1e-5, 1024,   HT6022_1MB}     // roll, 1000s display
 };
 
 
@@ -107,74 +173,127 @@ MainWindow::MainWindow(QWidget *parent):
   ui(new Ui::MainWindow)
 {
   ui->setupUi(this);
-  int res;
+  QElapsedTimer restore;
+  QTimer* saver;
+  char path[128];
+  int i;
 
-  if(!HT6022_Init())
-  {
-    QPalette* palette = new QPalette();
-    palette->setColor(QPalette::WindowText,Qt::yellow);
-    res= HT6022_FirmwareUpload();
-    if (res == HT6022_SUCCESS || res == HT6022_LOADED)
-    {
-      while((res = HT6022_DeviceOpen (&Device)) != 0)
-      {
-        sleep(1);
-        qDebug() << "Waiting for device..." << endl;
-        ui->statusBar->showMessage("Loading Firmware...",0);
-        QApplication::processEvents();
-      }
-
-      ui->checkBoxCH1ON->setChecked(true);
-      ui->checkBoxCH2ON->setChecked(true);
-
-      Channel1 = Channel[1];
-      Channel2 = Channel[1];
-      Channel1.VScale *= VScaleFactor;
-      Channel2.VScale *= VScaleFactor;
-      Channel1.Zero = Zero1[1];
-      Channel2.Zero = Zero2[1];
-
-      HT6022_SetCH1IR (&Device, HT6022_10V);
-      HT6022_SetCH2IR (&Device, HT6022_10V);
-      on_comboSampling_currentIndexChanged(TDIV_1MS);
-      read_cal_file();
-
-      worker.alive = 1;
-      worker.TriggerEdge = 1;
-      worker.TriggerChannel = 0;
-      worker.TriggerLevel = 128;                // equivalen to Dso.VTrigger = 0
-      worker.holdoff = 40;                                        // delay in ms
-
-      // ui->lblholdoff->setText("40.00ms");
-      ui->comboSampling->setCurrentIndex(TDIV_1MS);
-      ui->statusBar->showMessage("Device initialized.",0);
-
-      worker.start();
-      worker.blockSignals(1);
-      ui->actionSave_to_file->setEnabled(false);
-      //y1_vec.reserve(HT6022_1KB);  // 'c' code will write directly to std::vec
-      //y2_vec.reserve(HT6022_1KB);   // might want this if dynamicaly allocated
-      //x_vec.reserve(HT6022_1KB);           // allows re-sizing for 500ns range
-    }
-    else
-    {
-      exit(res);
-    }
-  }
-  else
+  Startup.start();                             // for time to first frame
+  if(HT6022_Init()) exit(-1);
+
+  Setup.TriggerEdge = 1;
+  Setup.TriggerChannel = 0;
+  Setup.TriggerLevel = 128;                     // equivalen to Dso.VTrigger = 0
+  Setup.Holdoff = 40;                                             // delay in ms
+
+  ui->checkBoxCH1ON->setChecked(true);
+  ui->checkBoxCH2ON->setChecked(true);
+
+  LoadCal();                       // the 'scope's own replaces it as it arrives
+  Channel1 = Channel[1];
+  Channel2 = Channel[1];
+  cal_channel(&Channel1, 0, &Cal);
+  cal_channel(&Channel2, 1, &Cal);
+  Setup.IR[0] = Channel1.VRange;
+  Setup.IR[1] = Channel2.VRange;
+  Channel1.Filter = &Filter1;
+  Channel2.Filter = &Filter2;
+  Channel1.Average = &Average1;
+  Channel2.Average = &Average2;
+  Channel1.Scale = &Scale1;
+  Channel2.Scale = &Scale2;
+
+  on_comboSampling_currentIndexChanged(TDIV_1MS);    // no device yet: settings
+
+  for(i = 0; i < DSO_UNITS; i++)
   {
-    exit(-1);
+    Unit[i] = i ? &aux[i-1] : &worker;
+    Unit[i]->Device = i ? &AuxDevice[i-1] : &Device;
+    Unit[i]->Unit = i;
+    Unit[i]->Configured = false;
+    Unit[i]->Connected = 0;                         // until a transfer succeeds
+    Unit[i]->Latest = NULL;                              // nothing captured yet
+    Unit[i]->Failed = NULL;
+    Unit[i]->Decoder = i ? NULL : &decoder;      // unit 0 streams to it rolling
+    Unit[i]->Triggered = 0;                           // nor held on a roll edge
+    frame_pool_init(&Unit[i]->Frames, FRAME_DEFAULT);     // allocated as needed
+    Unit[i]->alive = 1;
   }
+  for(i = 0; i < 2 * (DSO_UNITS - 1); i++) a_vec[i].resize(HT6022_1KB);
+
+  // ui->lblholdoff->setText("40.00ms");
+  ui->comboSampling->setCurrentIndex(TDIV_1MS);
+  ui->statusBar->showMessage("Waiting for device...",0);
+
+  Publish(true);                                // all units share the one setup
+  for(i = 0; i < DSO_UNITS; i++)
+    Unit[i]->start();                      // each idles until it has a device
+  worker.blockSignals(1);
+  decoder.alive = 1;
+  decoder.start();
+  ui->actionSave_to_file->setEnabled(false);
+  //y1_vec.reserve(HT6022_1KB);  // 'c' code will write directly to std::vec
+  //y2_vec.reserve(HT6022_1KB);   // might want this if dynamicaly allocated
+
   setupPlot(ui->customPlot);
   connect(&worker, SIGNAL(dataReady()), this, SLOT(updatePlot()));
+  for(i = 1; i < DSO_UNITS; i++)
+    connect(Unit[i], SIGNAL(dataReady()), this, SLOT(updateUnits()));
+  connect(&decoder, SIGNAL(decoded()), this, SLOT(onDecoded()));
+  qRegisterMetaType<HT6022_DeviceTypeDef>("HT6022_DeviceTypeDef");
+  connect
+  (
+    &device, SIGNAL(arrived(HT6022_DeviceTypeDef)),
+    this, SLOT(onDeviceArrived(HT6022_DeviceTypeDef))
+  );
+  connect(&device, SIGNAL(lost(int)), this, SLOT(onDeviceUnplugged(int)));
+  for(i = 0; i < DSO_UNITS; i++)
+    connect(Unit[i], SIGNAL(deviceLost(int)), this, SLOT(onDeviceLost(int)));
+  connect
+  (
+    &device, SIGNAL(status(QString)),
+    ui->statusBar, SLOT(showMessage(QString))
+  );
+
+  restore.start();
+  if(RestoreSession())                       // settings now, capture once shown
+    RestoreTime = restore.elapsed();
+  for(i = 0; i < REF_SLOTS; i++)            // as left, mapped so no time at all
+    if(ref_slot(path, sizeof(path), i)) ref_map(&Ref[i], path);
+  ShowRefs(true);
+  session.alive = 1;
+  session.start();
+  saver = new QTimer(this);                           // each second, if changed
+  connect(saver, SIGNAL(timeout()), this, SLOT(SaveSession()));
+  saver->start(1000);
+
+  device.alive = 1;                    // uploads firmware and opens 'scope
+  device.start();
 }
 
 void MainWindow::setupPlot(QCustomPlot *customPlot)
 {
+  static const Qt::PenStyle style[3] =
+    {Qt::DashLine, Qt::DotLine, Qt::DashDotLine};
+  static const QColor refColour[REF_SLOTS] =
+    {Qt::white, QColor(255, 160, 0), QColor(255, 128, 192), Qt::lightGray};
+  QPen pen;
+  int i;
+
   customPlot->setBackground(Qt::black);
-  // create graph and assign data to it:
-  customPlot->addGraph();
-  customPlot->addGraph();
+  customPlot->setCurrentLayer("traces");  // redrawn alone each frame: trace.cpp
+  for(i = 0; i < 2 + 2 * DSO_UNITS; i++)   // drawn from y1_vec etc. as they lie
+  {
+    vTrace[i] = new traceGraph(customPlot->xAxis, customPlot->yAxis);
+    customPlot->addPlottable(vTrace[i]);
+  }
+  for(i = 0; i < 2 * REF_SLOTS; i++)                 // and from r_vec, likewise
+  {
+    vRef[i] = new traceGraph(customPlot->xAxis, customPlot->yAxis);
+    customPlot->addPlottable(vRef[i]);
+    r_vec[i].resize(HT6022_1KB);
+  }
+  customPlot->setCurrentLayer("main");             // cursors, mask and labels
 
   vCursorX1 = new QCPItemLine(customPlot);
   vCursorX1->setPen(QColor(Qt::white));
@@ -183,6 +302,22 @@ void MainWindow::setupPlot(QCustomPlot *customPlot)
   vCursorTrigger = new QCPItemLine(customPlot);
   vCursorTrigger->setPen(QColor(Qt::darkYellow));
 
+  for(i = 0; i < MASK_POLYGONS; i++)
+  {
+    vMask[i] = new QCPCurve(customPlot->xAxis, customPlot->yAxis);
+    customPlot->addPlottable(vMask[i]);
+    vMask[i]->setPen(QPen(QColor(255, 0, 0, 160)));
+  }
+
+  for(i = 0; i < DECODE_SHOWN; i++)
+  {
+    vDecode[i] = new QCPItemText(customPlot);
+    vDecode[i]->setColor(Qt::white);
+    vDecode[i]->setPen(QPen(Qt::darkGray));
+    vDecode[i]->setPadding(QMargins(2, 1, 2, 1));
+    vDecode[i]->setVisible(false);
+  }
+
   customPlot->xAxis->setTickLabels(0);
   customPlot->yAxis->setTickLabels(0);
   customPlot->xAxis->setRange(0, 10 * Dso.Tdiv);
@@ -191,9 +326,25 @@ void MainWindow::setupPlot(QCustomPlot *customPlot)
   customPlot->xAxis->setTickStep(Dso.Tdiv);
   customPlot->yAxis->setAutoTickStep(false);
   customPlot->yAxis->setTickStep(0.25);
-  customPlot->graph(0)->setPen(QPen(Qt::yellow));
+  vTrace[0]->setPen(QPen(Qt::yellow));
   customPlot->axisRect()->setBackground(Qt::black);
-  customPlot->graph(1)->setPen(QPen(Qt::cyan));
+  vTrace[1]->setPen(QPen(Qt::cyan));
+  vTrace[2]->setPen(QPen(Qt::magenta));                          // math traces
+  vTrace[3]->setPen(QPen(Qt::green));
+  for(i = 1; i < DSO_UNITS; i++)             // further units: CH1 and CH2
+  {
+    pen.setStyle(style[(i - 1) % 3]);
+    pen.setColor(Qt::yellow);
+    vTrace[2 + 2*i]->setPen(pen);
+    pen.setColor(Qt::cyan);
+    vTrace[3 + 2*i]->setPen(pen);
+  }
+  for(i = 0; i < 2 * REF_SLOTS; i++)             // REFn: one colour, CH2 dotted
+  {
+    pen.setStyle(i % 2 ? Qt::DotLine : Qt::SolidLine);
+    pen.setColor(refColour[i / 2]);
+    vRef[i]->setPen(pen);
+  }
   customPlot->setInteractions(QCP::iRangeDrag);
   connect
   (
@@ -207,21 +358,29 @@ void MainWindow::setupPlot(QCustomPlot *customPlot)
 
 void MainWindow::SetTriggerLine(DSO_CHANNEL* Channel)  // pos of horiz trig line
 {
-  double VTrigger;
+  const DSO_SCALE* s = Channel->Scale;
+  double code;
+  double y;
 
-  VTrigger = Channel->Inv ? -Dso.VTrigger : Dso.VTrigger;
+  scale_update(Channel);
+  code = scale_code(s, Dso.VTrigger);
+  y = s->ScreenZero + s->ScreenStep * code;             // where traces cross it
 
-  vCursorTrigger->start->setCoords
-  (
-    -1, VTrigger/(4*Channel->Vdiv)+Channel->VOffset
-  );
-  vCursorTrigger->end->setCoords
-  (
-    1, VTrigger/(4*Channel->Vdiv)+Channel->VOffset
-  );
+  vCursorTrigger->start->setCoords(-1, y);
+  vCursorTrigger->end->setCoords(1, y);
+  ui->customPlot->invalidate();                 // next frame redraws it all
 
-  worker.TriggerLevel =
-    (unsigned char)(Dso.VTrigger * 128 /Channel->VScale + 128 + Channel->Zero);
+  Setup.TriggerLevel = code < 0 ? 0 : code > 255 ? 255 : (unsigned char)code;
+  Publish(false);
+}
+
+
+void MainWindow::Publish(bool arm)       // hand current settings to the workers
+{
+  Setup.Dso = Dso;
+  Setup.Mode = Dso.Status == RUN ? Dso.Mode : HOLD;
+  if(arm) Setup.Arm++;                            // workers take up Mode afresh
+  settings_publish(&Setup);
 }
 
 
@@ -237,69 +396,153 @@ void MainWindow::onYRangeChanged(const QCPRange &range)
 
 MainWindow::~MainWindow()
 {
+  on_actionExit_triggered();          // saves the session while controls remain
   delete ui;
-  on_actionExit_triggered();
 }
 
 
 void MainWindow::updatePlot()            // invoked by signal from worker thread
 {
   // timer.start();
+  DSO_FRAME* Frame;                             // capture, with settings pinned
+  DSO_SET View;                               // timing to show the capture with
+  int ets = 0;                             // bins shown in place of the capture
+  int i;
+
+  ShowRefs(false);                       // only should timebase etc. have moved
+  scale_update(&Channel1);                     // likewise range, gain or offset
+  scale_update(&Channel2);
+  if((Frame = worker.failed()))                  // as the worker handed it over
+  {
+    mask_save(&Mask, Frame->Data, &Frame->Settings.Dso, Frame->TriggerPoint);
+    frame_release(Frame);
+  }
+  if(Setup.Roll)                            // strip chart, rather than captures
+  {
+    RollPlot();
+    return;
+  }
 
-  if(Dso.Mode == SINGLE)                                          // Single shot
+  Frame = TakeFrame(0);
+  if(Frame == NULL) return;                           // nothing captured as yet
+
+  if(Mask.Stopped)                         // worker held on a mask failure ...
   {
-    if(worker.mode == HOLD)                                     // triggered ...
+    Mask.Stopped = false;
+    worker.blockSignals(1);                   // ... so stop as for single shot
+    Dso.Status = STOP;
+    Publish(true);
+    ui->btnGet->setText("ARM");
+    ui->actionSave_to_file->setEnabled(true);
+  }
+  else if(Dso.Mode == SINGLE)                                     // Single shot
+  {                                   // triggered since last armed, so stop ...
+    if(worker.mode == HOLD && Frame->Settings.Arm == Setup.Arm)
     {
-      worker.blockSignals(1);                 // ... so stop further updates ...
+      worker.blockSignals(1);                         // ... further updates ...
       Dso.Status = STOP;
       ui->btnGet->setText("ARM");                    // ... and invite re-arming
       ui->actionSave_to_file->setEnabled(true);
     }
   }
-  else
-  {
-    if(Dso.Status == RUN) worker.mode = Dso.Mode;
-    else worker.mode = HOLD;
-  }
 
-  if(worker.TriggerPoint == 0)
+  if(Frame->TriggerPoint == 0)
   {             // In AUTO, wait ~200ms before resuming scan without trigger ...
     if(withhold++ < 5) return;                       // ... like analoge 'scope
   }                 // makes display more stable in AUTO when timebase < 2us/div
   else withhold = 0;
+                          // read under the previous SR or ranges: discard it
+  if(Dso.Status == RUN && Frame->Settings.Config != Setup.Config) return;
 
+  settings_view(&View, &Dso, &Frame->Settings);       // the data, as now viewed
   if
   (
     get_post_trigger_waveforms            // consider adding pre-trigger version
     (
-      (double*)&y1_vec[0],
-      (double*)&y2_vec[0],
-      (double*)&x_vec[0],
-      worker.CH0,
+      y1_vec.data(),
+      y2_vec.data(),
+      &Axis,
+      m1_vec.data(),
+      m2_vec.data(),
+      Frame,
+      &View,
       &Channel1,
       &Channel2,
-      worker.TriggerPoint,
-      worker.TriggerEdge
+      Math
     ) < 0                                         // nothing to plot if negative
   ) return;
 
-  if(Calibrate)
+  if(Setup.Ets)                           // worker has binned this and the rest
   {
-    do_cal(worker.CH0, Calibrate);
-    Calibrate--;
-    if(Calibrate == 0) ui->statusBar->showMessage("Offset Null Completed",0);
+    worker.EtsLock.lock();
+    ets = get_ets_waveforms
+    (
+      y1_vec.data(), y2_vec.data(), &Axis, &worker.Ets, &View,
+      &Channel1, &Channel2
+    );
+    worker.EtsLock.unlock();
   }
 
-  ui->customPlot->graph(0)->clearData();
-  ui->customPlot->graph(1)->clearData();
+  ShowJitter();
+  UpdateMask(false);
+  SubmitDecode();
+
+  if(Calibrating) Calibration(Frame);
+
+  for(i = 0; i < 4; i++) vTrace[i]->clearData();
 
   if(Channel1.Enabled)
-    ui->customPlot->graph(0)->setData(x_vec,y1_vec);
+    vTrace[0]->setData(&Axis, y1_vec.data(), HT6022_1KB);
 
   if(Channel2.Enabled)
-    ui->customPlot->graph(1)->setData(x_vec,y2_vec);
+    vTrace[1]->setData(&Axis, y2_vec.data(), HT6022_1KB);
 
-  ui->customPlot->replot();
+  if(Math[0].Enabled && !ets)                   // single acquisitions, as timed
+    vTrace[2]->setData(&Axis, m1_vec.data(), HT6022_1KB);
+
+  if(Math[1].Enabled && !ets)
+    vTrace[3]->setData(&Axis, m2_vec.data(), HT6022_1KB);
+
+  PlotUnits(ets != 0);
+
+  ui->customPlot->replotTraces();           // rest as last drawn, unless moved
+  ShowBuffers();
+
+  if(Switching && Frame->Settings.Config == Setup.Config)
+  {
+    Switching = false;
+    ui->statusBar->showMessage
+    (
+      ui->statusBar->currentMessage().section(" [", 0, 0) +
+      QString(" [switched in %1ms, %2us at the 'scope]")
+        .arg(Switch.elapsed()).arg(worker.SwitchTime), 0
+    );
+  }
+
+  if(FirstFrame && worker.Frame != ArrivalFrame)
+  {
+    FirstFrame = false;
+    ui->statusBar->showMessage
+    (
+      QString("First frame after %1ms, device open after %2ms")
+        .arg(Startup.elapsed()).arg(OpenTime) +
+      (
+        RestoreTime < 0 ? QString() :
+        QString(", session restored in %1ms").arg(RestoreTime)
+      ), 0
+    );
+  }
+  else if(Mask.Enabled)
+    ui->statusBar->showMessage
+    (
+      QString("Mask CH%1: %2 passed, %3 failed")
+        .arg(Mask.Channel + 1).arg(Mask.Passes).arg(Mask.Fails) +
+      (
+        Mask.FirstFail < 0 ? QString() :
+        QString(", last at %1 div")
+          .arg(Mask.FirstFail * Dso.Ts * Dso.SubSample / Dso.Tdiv, 0, 'f', 2)
+      ), 0
+    );
 
   // qDebug() << "Time: " << timer.nsecsElapsed() << "ns";
 }
@@ -314,16 +557,17 @@ void MainWindow::on_btnGet_clicked()                    // Toggle capture / hold
     Dso.Status = RUN;    
     if(Dso.Mode == SINGLE)
     {
-       worker.mode = SINGLE;
        ui->btnGet->setText("READY");
     }
     else ui->btnGet->setText("STOP");
+    Publish(true);                                     // SINGLE, AUTO or NORMAL
   }
   else if(Dso.Status == RUN)
   {
      ui->actionSave_to_file->setEnabled(true);
      worker.blockSignals(1);
      Dso.Status = STOP;
+     Publish(true);                                                      // HOLD
      ui->btnGet->setText("ARM");
   }
 }
@@ -343,7 +587,8 @@ void MainWindow::on_comboBox_4_currentIndexChanged(int index)
 
 void MainWindow::on_comboBox_rise_currentIndexChanged(int index)        // slope
 {
-  worker.TriggerEdge = index?0:1;
+  Setup.TriggerEdge = index?0:1;
+  Publish(false);
 }
 
 
@@ -352,14 +597,14 @@ void MainWindow::on_comboBoxCHSel_currentIndexChanged(int index)
   Dso.ChTrigger = index + 1;
   if(Dso.ChTrigger == 1)
   {
-    worker.TriggerChannel = 0;
+    Setup.TriggerChannel = 0;
     Channel1.Enabled = true;
     ui->checkBoxCH1ON->setChecked(true);
     SetTriggerLine(&Channel1);
   }
   else
   {
-    worker.TriggerChannel = 1;
+    Setup.TriggerChannel = 1;
     Channel2.Enabled = true;
     ui->checkBoxCH2ON->setChecked(true);
     SetTriggerLine(&Channel2);
@@ -388,7 +633,8 @@ void MainWindow::on_dialHoldoff_valueChanged(int value)      // 0-200ms hold off
 {
   char valueStr[10];
 
-  worker.holdoff = value;
+  Setup.Holdoff = value;
+  Publish(false);
   float2engStr(valueStr,(double)value/1000);
   ui->lblholdoff->setText(valueStr);
 }
@@ -401,7 +647,6 @@ void MainWindow::on_dialDelay_valueChanged(int pos) // Delayed Trig: 0-2,000,000
   static int base = 0;                 // centre point of expanded control range
   static int vernier = 10;
 
-  int i;
   double value;                                    // cumulative control setting
   double delay;                                      // trigger delay in seconds
   double delta;                           // delay integer truncation correction
@@ -427,15 +672,16 @@ void MainWindow::on_dialDelay_valueChanged(int pos) // Delayed Trig: 0-2,000,000
   if(Dso.Ts > 1/16e6) value /= Dso.Ts*16e6;
 
   Dso.TriggerDelay = (int)value;
+  average_reset(&Average1);                   // traces no longer line up
+  average_reset(&Average2);
   delta = value - (double)Dso.TriggerDelay;
   delay = value * Dso.Ts;
   delta *= Dso.Ts;
   Dso.TriggerOffset = delta;
 
-    // Changing delay invalidates the timings in x_vec so we need a way to clear
-    // it.  This is a horrible way to suppress partial traces on the display ...
-  for(i = 0; i < HT6022_1KB; i++) x_vec[i] = DBL_MAX;       // ... but it works!
+  axis_clear(&Axis);        // old timings no longer apply: nothing to draw
 
+  Publish(false);
   float2engStr(valueStr, delay);
   ui->lblfreq->setText(valueStr);
   if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
@@ -464,7 +710,7 @@ void MainWindow::on_comboSampling_currentIndexChanged(int index)     // Timebase
     HT6022_1KB/2   // 1us
   };
 
-  static const char* msg[21] =              // sample rate, t/div, buffer length
+  static const char* msg[TDIV_100S + 1] =   // sample rate, t/div, buffer length
   {
     "48Ms/s, 20ns/div, 20us",
     "48Ms/s, 50ns/div, 20us",
@@ -486,13 +732,22 @@ void MainWindow::on_comboSampling_currentIndexChanged(int index)     // Timebase
     "8Ms/s, 10ms/div, 128ms",
     "4Ms/s, 20ms/div, 256ms",
     "1Ms/s, 50ms/div, 1s",
-    "1Ms/s, 100ms/div, 1s"
+    "1Ms/s, 100ms/div, 1s",
+    "500Ks/s, 200ms/div, roll",
+    "200Ks/s, 500ms/div, roll",
+    "100Ks/s, 1s/div, roll",
+    "100Ks/s, 2s/div, roll",
+    "100Ks/s, 5s/div, roll",
+    "100Ks/s, 10s/div, roll",
+    "100Ks/s, 20s/div, roll",
+    "100Ks/s, 50s/div, roll",
+    "100Ks/s, 100s/div, roll"
   };
 
   HT6022_SRTypeDef SR;
   int i;
 
-  if(index < 0 || index > 21) return;
+  if(index < 0 || index > TDIV_100S) return;
   if
   (
     (Dso.Status == STOP || Dso.Mode == SINGLE) &&        // stored trace display
@@ -517,12 +772,22 @@ void MainWindow::on_comboSampling_currentIndexChanged(int index)     // Timebase
   else Dso.DisplayDepth = (int)HT6022_1KB;
 
   for(i = 0; i < HT6022_1KB; i++) y1_vec[i] = 0, y2_vec[i] = 0;
+  for(i = 0; i < HT6022_1KB; i++) m1_vec[i] = 0, m2_vec[i] = 0;
+  average_reset(&Average1);
+  average_reset(&Average2);
 
   ui->customPlot->xAxis->setRange(0, 10 * Dso.Tdiv);
   ui->customPlot->xAxis->setAutoTickStep(false);
   ui->customPlot->xAxis->setTickStep(Dso.Tdiv);
 
-  HT6022_SetSR (&Device,SR);
+  ui->actionEts->setEnabled(index <= TDIV_500NS);       // where it is upsampled
+  if(index > TDIV_500NS) ui->actionEts->setChecked(false);
+  ui->actionRoll->setEnabled(index >= TDIV_50MS && index < TDIV_200MS);
+  if(index < TDIV_50MS) ui->actionRoll->setChecked(false);  // columns under 1ms
+  if(index >= TDIV_200MS) ui->actionRoll->setChecked(true);  // records: minutes
+
+  ApplySR(SR);
+  Publish(false);
 
   if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
   ui->statusBar->showMessage(msg[index],0);
@@ -553,6 +818,7 @@ void MainWindow::on_checkBoxCH1Inv_toggled(bool checked)
 void MainWindow::on_checkBoxCH1Glitch_toggled(bool checked)
 {
   Channel1.Glitch = checked;
+  average_reset(&Average1);
 }
 
 
@@ -605,10 +871,10 @@ void MainWindow::on_comboBoxV1div_currentIndexChanged(int index)     // Volt/Div
 
   Channel1.VRange = Channel[index].VRange;
   Channel1.Vdiv = Channel[index].Vdiv;
-  Channel1.VScale = Channel[index].VScale * VScaleFactor;
-  Channel1.Zero = Zero1[index];                   // correct amp offset by range
+  cal_channel(&Channel1, 0, &Cal);                // correct amp offset and gain
   Channel1.index = index;
-  HT6022_SetCH1IR (&Device, Channel1.VRange);
+  average_reset(&Average1);
+  ApplyIR(0, Channel1.VRange);
   if(Dso.ChTrigger == 1) SetTriggerLine(&Channel1);
   if(VarCH1 == POSITION)
     sprintf(valueStr,"%4.3fV",Channel1.VOffset*Channel1.Vdiv*4.0);
@@ -642,6 +908,7 @@ void MainWindow::on_checkBoxCH2Inv_toggled(bool checked)
 void MainWindow::on_checkBoxCH2Glitch_toggled(bool checked)
 {
   Channel2.Glitch = checked;
+  average_reset(&Average2);
 }
 
 
@@ -694,10 +961,10 @@ void MainWindow::on_comboBoxV2div_currentIndexChanged(int index)     // Volt/Div
 
   Channel2.VRange = Channel[index].VRange;
   Channel2.Vdiv = Channel[index].Vdiv;
-  Channel2.VScale = Channel[index].VScale * VScaleFactor;
-  Channel2.Zero = Zero2[index];                   // correct amp offset by range
+  cal_channel(&Channel2, 1, &Cal);                // correct amp offset and gain
   Channel2.index = index;
-  HT6022_SetCH2IR (&Device, Channel2.VRange);
+  average_reset(&Average2);
+  ApplyIR(1, Channel2.VRange);
   if(Dso.ChTrigger == 2) SetTriggerLine(&Channel2);
   if(VarCH2 == POSITION)
     sprintf(valueStr,"%4.3fV",Channel2.VOffset*Channel2.Vdiv*4.0);
@@ -709,15 +976,34 @@ void MainWindow::on_comboBoxV2div_currentIndexChanged(int index)     // Volt/Div
 
 void MainWindow::on_actionSave_to_file_triggered()
 {
-  write_tracefile(worker.CH0, Dso.MemDepth);
+  DSO_FRAME* Frame = Shown[0];                 // as held on screen when stopped
+
+  if(Frame)
+    write_tracefile
+      (Frame->Data, Frame->Settings.Dso.MemDepth, Frame->Settings.Dso.Ts);
 }
 
 
 void MainWindow::on_actionExit_triggered()
 {
-  worker.alive = 0;                                          // terminate thread
+  int i;
+
+  SaveSession();                              // as left, should it have changed
+  session.alive = 0;                           // written before the thread ends
+  for(i = 0; i < DSO_UNITS; i++) Unit[i]->alive = 0;        // terminate threads
+  decoder.alive = 0;
+  device.alive = 0;
   sleep(1);                 // allow time for worker thread to terminate cleanly
-  HT6022_DeviceClose(&Device);                               // shut down 'scope
+  session.wait(5000);                        // a 2MB capture may still be going
+  worker.LogLock.lock();
+  log_close(&worker.Log);                         // last interval and its block
+  worker.LogLock.unlock();
+  for(i = 0; i < DSO_UNITS; i++)
+  {
+    Unit[i]->DeviceLock.lock();
+    HT6022_DeviceClose(Unit[i]->Device);                     // shut down 'scope
+    Unit[i]->DeviceLock.unlock();
+  }
   HT6022_Exit();
   qDebug() << "Exiting\r\n";
   exit(0);
@@ -730,18 +1016,1520 @@ void MainWindow::on_actionOffset_Null_triggered()        // offset null by range
 
   msgBox.setText("Connect both probes to gound    ");
   msgBox.exec();
+  StartCal(false, 0);
+}
+
+
+void MainWindow::on_actionGain_Cal_triggered()       // offset and gain by range
+{
+  static double volts = 2.0;                      // as the calibrator is marked
+  bool ok;
+
+  volts = QInputDialog::getDouble
+  (
+    this, "Gain Calibration",
+    "Connect both probes, set to x1, to the calibrator.\n"
+    "Its output, volts p-p:", volts, 0.1, 5, 3, &ok
+  );
+  if(ok) StartCal(true, volts);
+}
+
+
+void MainWindow::LoadCal()           // as last saved, else the defaults, in Cal
+{
+  char path[128];
+
+  cal_default(&Cal);
+  if(cal_path(path, sizeof(path)) && cal_read(path, &Cal)) return;
+  if(get_home_path(path, CAL_LEGACY, sizeof(path)))
+    cal_read_legacy(path, &Cal);                      // kept until next written
+}
+
+
+void MainWindow::ApplyCal()                     // to the channels as now ranged
+{
+  cal_channel(&Channel1, 0, &Cal);
+  cal_channel(&Channel2, 1, &Cal);
+  SetTriggerLine(Dso.ChTrigger == 2 ? &Channel2 : &Channel1);
+}
+
 
-  Calibrate = 25;                // magic number: state variable for calibration
+void MainWindow::StartCal(bool gain, double volts)         // each range in turn
+{
+  cal_start(&CalRun, &Cal, gain, volts);
+  if(!Calibrating) CalMode = Dso.Mode;
+  Calibrating = true;
+  Dso.Mode = AUTO;                           // acquisitions whatever the signal
   Dso.Status = RUN;                             // make sure we are getting data
+  Setup.IR[0] = Setup.IR[1] = cal_ir(CalRun.Range);
+  Setup.Config++;
+  Publish(true);
   ui->btnGet->setText("STOP");
   worker.blockSignals(0);
+  ui->statusBar->showMessage("Calibrating...", 0);
+}
+
+
+void MainWindow::Calibration(DSO_FRAME* Frame)           // each new acquisition
+{
+  static unsigned int frame;
+  FRAME_CHANNEL CH1 = frame_channel(Frame, 0);
+  FRAME_CHANNEL CH2 = frame_channel(Frame, 1);
+  HT6022_IRTypeDef IR = cal_ir(CalRun.Range);
+  QString msg;
+  char path[128];
+  bool saved;
+  int gains = 0;
+  int i;
+
+  if
+  (
+    Frame->Sequence == frame || Frame->Settings.Config != Setup.Config ||
+    Frame->Settings.IR[0] != IR || Frame->Settings.IR[1] != IR
+  ) return;                                      // seen, or taken before switch
+  frame = Frame->Sequence;
+  if(!cal_feed(&CalRun, &CH1, &CH2)) return;
+  if(CalRun.Range < CAL_RANGES)
+  {
+    Setup.IR[0] = Setup.IR[1] = cal_ir(CalRun.Range);
+    Setup.Config++;
+    Publish(false);
+    return;
+  }
+
+  Calibrating = false;
+  Cal = CalRun.Result;
+  saved = cal_path(path, sizeof(path)) && cal_write(path, &Cal);
+
+  Setup.IR[0] = Channel1.VRange;                   // restore original range ...
+  Setup.IR[1] = Channel2.VRange;
+  Setup.Config++;
+  Dso.Mode = CalMode;                                    // ... and trigger mode
+  Publish(true);
+  ApplyCal();
+
+  for(i = 0; i < 2 * CAL_RANGES; i++) gains += CalRun.Gains >> i & 1;
+  msg = CalRun.Offsets == (1u << 2 * CAL_RANGES) - 1 ?
+    "Calibration completed" : "Calibration incomplete: check the probes";
+  if(CalRun.Gain) msg += QString(", %1 of 8 gains measured").arg(gains);
+  if(!saved) msg += ", not saved to file";
+  ui->statusBar->showMessage(msg, 0);
+  QTimer::singleShot(0, this, SLOT(StoreCal()));   // asked once drawn, not here
+}
+
+
+void MainWindow::StoreCal()         // in the 'scope as well, if the user agrees
+{
+  unsigned char block[CAL_EEPROM];
+  unsigned char found[CAL_EEPROM];
+  DSO_CAL check;
+  QString msg = ui->statusBar->currentMessage();
+  bool fetched;
+  bool known;
+  bool stored;
+
+  if
+  (
+    Device.DeviceHandle &&
+    QMessageBox::question
+    (
+      this, "Calibration",
+      "Store the calibration in the 'scope's EEPROM as well?\n"
+      "It replaces the offsets Hantek's software keeps there, which are\n"
+      "first copied to .scope_cal.orig in the home directory.",
+      QMessageBox::Yes | QMessageBox::No
+    ) == QMessageBox::Yes
+  )
+  {
+    cal_pack(&Cal, block);
+    worker.DeviceLock.lock();                       // the one it was taken from
+    fetched = cal_fetch(&Device, found);            // reads that agree, and ...
+    known = fetched && (cal_unpack(&check, found) || cal_hantek(found));
+    stored =                                       // ... a block we can restore
+      known && cal_keep_original(found) &&
+      HT6022_SetCalValues(&Device, block, CAL_EEPROM) == HT6022_SUCCESS;
+    worker.DeviceLock.unlock();
+    if(!fetched) msg += ", not stored in 'scope: its EEPROM reads differ";
+    else if(!known) msg += ", not stored in 'scope: its EEPROM is not Hantek's";
+    else if(!stored) msg += ", not stored in 'scope";
+  }
+  else msg += ", not stored in 'scope";
+  ui->statusBar->showMessage(msg, 0);
+}
+
+
+void MainWindow::on_actionCalRead_triggered()    // each 'scope's own, if it has
+{
+  QString msg;
+  int i;
+
+  for(i = 0; i < DSO_UNITS; i++)
+    if(Unit[i]->Device->DeviceHandle)
+      msg += QString(" %1: %2.").arg(i + 1).arg(ReadCalDevice(i));
+  ui->statusBar->showMessage
+  (
+    msg.isEmpty() ? QString("No 'scope to read") :
+    QString("EEPROM calibration, 'scope") + msg, 0
+  );
+}
+
+
+QString MainWindow::ReadCalDevice(int unit)     // only when asked: see DSOcal.c
+{
+  DSO_CAL found;
+  unsigned char block[CAL_EEPROM];
+  unsigned char saved[CAL_EEPROM];
+  bool ok;
+
+  Unit[unit]->DeviceLock.lock();
+  ok = cal_fetch(Unit[unit]->Device, block);
+  Unit[unit]->DeviceLock.unlock();
+  if(!ok) return "reads differ, not used";
+  if(!cal_unpack(&found, block)) return "none stored";
+  if(unit)                                      // merged view: see updatePlot()
+  {
+    AuxOwnCal[unit - 1] = true;
+    AuxCal[unit - 1] = found;
+    return "in use";
+  }
+  cal_pack(&Cal, saved);
+  if(!memcmp(block, saved, sizeof(block))) return "as .scope_cal";      // finer
+
+  Cal = found;                                                 // another 'scope
+  ApplyCal();
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
+  return "in use in place of .scope_cal";
+}
+
+
+void MainWindow::on_actionBenchmark_triggered()   // trace drawing, as now shown
+{
+  const int frames = 200;
+  bool raster = ui->customPlot->Raster;
+  QElapsedTimer t;
+  qint64 us[2];
+  int k;
+  int i;
+
+  for(k = 0; k < 2; k++)                                // QPainter, then raster
+  {
+    ui->customPlot->Raster = k;
+    ui->customPlot->replot();                     // Static drawn outside timing
+    t.start();
+    for(i = 0; i < frames; i++) ui->customPlot->replotTraces();
+    us[k] = t.nsecsElapsed() / 1000 / frames;
+  }
+  ui->customPlot->Raster = raster;
+  ui->statusBar->showMessage
+  (
+    QString("Traces: QPainter %1us, raster %2us per frame")
+      .arg(us[0]).arg(us[1]), 0
+  );
+}
+
+
+void MainWindow::on_actionTriggerTest_triggered()     // against simulated edges
+{
+  DSO_SIM sim;
+  SIM_TRIGGER_STATS stats[2];
+  int k;
+
+  for(k = 0; k < 2; k++)               // each 1KB read afresh, then as a stream
+  {
+    sim.Shape = SIM_SINE;
+    sim.Period = 37.3;                          // edges land all over each read
+    sim.Phase = 3.2;
+    sim.Amplitude = 100;
+    sim.Offset = 128;
+    sim.Noise = 2;
+    sim.Seed = 12345;
+    sim.Position = 0;
+    sim_trigger_test(&sim, HT6022_1KB, 1000, k, TRIGGER_HYSTERESIS, &stats[k]);
+  }
+  ui->statusBar->showMessage
+  (
+    QString("Trigger: %1 edges; per read %2 missed, %3 false; "
+      "streamed %4 missed, %5 false")
+      .arg(stats[0].Edges).arg(stats[0].Missed).arg(stats[0].False)
+      .arg(stats[1].Missed).arg(stats[1].False), 0
+  );
+}
+
+
+void MainWindow::on_actionJitterTest_triggered()      // overlay of a 10MHz sine
+{
+  const char* name[3] = {"linear", "cubic", "sinc"};
+  DSO_SIM sim;
+  SIM_JITTER_STATS stats;
+  QString msg = "Trigger jitter at 48MSa/s:";
+  int k;
+
+  for(k = TRIGGER_LINEAR; k <= TRIGGER_SINC; k++)
+  {
+    sim.Shape = SIM_SINE;
+    sim.Period = 4.8;                                       // samples per cycle
+    sim.Amplitude = 100;
+    sim.Offset = 128;
+    sim.Noise = 0.5;
+    sim.Seed = 12345;
+    sim_jitter_test(&sim, 2000, (TRIGGER_INTERP_TypeDef)k, &stats);
+    msg += QString(" %1 %2ps (%3ps estimated)").arg(name[k])
+      .arg(stats.Error / 48e6 * 1e12, 0, 'f', 0)
+      .arg(stats.Estimate / 48e6 * 1e12, 0, 'f', 0);
+  }
+  ui->statusBar->showMessage(msg, 0);
+}
+
+
+void MainWindow::on_actionCalTest_triggered()     // errors injected, then found
+{
+  static DSO_CAL inject;
+  static const double offset[2][CAL_RANGES] = {{-3.4, 1.7, 5.2, 9.9},
+    {8.8, 10.3, 11.6, -12.1}};
+  static const double gain[2][CAL_RANGES] = {{1.031, 0.972, 1.054, 0.96},
+    {0.985, 1.047, 1.012, 0.953}};
+  DSO_SIM sim;
+  SIM_CAL_STATS stats;
+  QElapsedTimer t;
+  int offsets = 0;
+  int gains = 0;
+  int i;
+
+  memcpy(inject.Offset, offset, sizeof(offset));
+  memcpy(inject.Gain, gain, sizeof(gain));
+  sim.Period = 1000;                                      // 1KHz at 1MSa/s, say
+  sim.Phase = 123.4;
+  sim.Noise = 1.5;
+  sim.Seed = 12345;
+  sim.Position = 0;
+  t.start();
+  sim_cal_test(&sim, &inject, 2.0, &stats);
+  for(i = 0; i < 2 * CAL_RANGES; i++)
+  {
+    offsets += stats.Offsets >> i & 1;
+    gains += stats.Gains >> i & 1;       // 2V and 1V ranges clip the calibrator
+  }
+  ui->statusBar->showMessage
+  (
+    QString("Calibration: %1 of 8 offsets within %2 codes, %3 of 8 gains "
+      "within %4%, in %5ms")
+      .arg(offsets).arg(stats.Offset, 0, 'f', 3)
+      .arg(gains).arg(stats.Gain * 100, 0, 'f', 3)
+      .arg(t.elapsed()), 0
+  );
+}
+
+
+// Display
+
+void MainWindow::on_actionDots_toggled(bool checked)
+{
+  ui->customPlot->Dots = checked;
+  ui->customPlot->replotTraces();
+}
+
+
+void MainWindow::on_actionRaster_toggled(bool checked)
+{
+  ui->customPlot->Raster = checked;
+  ui->customPlot->replotTraces();
+}
+
+
+// Math
+
+void MainWindow::SetMath(int trace)          // edit expression and sensitivity
+{
+  QString label;
+  QString expr;
+  double Vdiv;
+  bool ok;
+  int err;
+
+  label = QString("Math %1").arg(trace + 1);
+  expr = QInputDialog::getText
+  (
+    this, label,
+    "A, B, + - *, abs() int() diff() filt(x,n); blank to turn off",
+    QLineEdit::Normal, Math[trace].Expr, &ok
+  );
+  if(!ok) return;
+
+  err = math_compile(&Math[trace], expr.toLatin1().constData());
+  if(err)
+  {
+    QMessageBox::warning
+    (
+      this, label, QString("Syntax error at character %1").arg(err)
+    );
+    return;
+  }
+  if(!Math[trace].Enabled)
+  {
+    vTrace[2 + trace]->clearData();
+    ui->customPlot->replot();
+    return;
+  }
+
+  Vdiv = QInputDialog::getDouble
+  (
+    this, label, "Units/div", Math[trace].Vdiv, 1e-12, 1e12, 6, &ok
+  );
+  if(ok) Math[trace].Vdiv = Vdiv;
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
+}
+
+
+void MainWindow::on_actionMath1_triggered()
+{
+  SetMath(0);
+}
+
+
+void MainWindow::on_actionMath2_triggered()
+{
+  SetMath(1);
+}
+
+
+// Filter
+
+void MainWindow::SetFilter(DSO_FILTER* Filter, const QString &label)
+{
+  static const QStringList types = QStringList()
+    << "Off"
+    << "Low pass, IIR" << "High pass, IIR" << "Notch, IIR"
+    << "Low pass, FIR" << "High pass, FIR" << "Notch, FIR";
+
+  QString type;
+  double Fc;
+  bool ok;
+  int i;
+  int n;
+
+  i = Filter->Type == FILTER_OFF ? 0 :
+    Filter->Type + (Filter->Design == FILTER_FIR ? 3 : 0);
+  type = QInputDialog::getItem(this, label, "Filter", types, i, false, &ok);
+  if(!ok) return;
+  i = types.indexOf(type);
+
+  if(i > 0)
+  {
+    Fc = QInputDialog::getDouble
+    (
+      this, label, i % 3 == 0 ? "Notch (Hz)" : "Corner (Hz)",
+      Filter->Fc, 1, 24e6, 0, &ok
+    );
+    if(!ok) return;
+    Filter->Fc = Fc;
+
+    if(i == 3 || i == 6)
+    {
+      Filter->Q = QInputDialog::getDouble
+        (this, label, "Notch Q", Filter->Q, 0.5, 100, 1, &ok);
+    }
+    else if(i < 3)
+    {
+      n = QInputDialog::getInt
+      (
+        this, label, "Order", Filter->Order <= 8 ? Filter->Order : 4,
+        2, 8, 2, &ok
+      );
+      if(ok) Filter->Order = n;
+    }
+    else
+    {
+      n = QInputDialog::getInt
+      (
+        this, label, "Taps", Filter->Order > 8 ? Filter->Order : 63,
+        3, FILTER_TAPS, 2, &ok
+      );
+      if(ok) Filter->Order = n;
+    }
+  }
+
+  Filter->Type = i ? (FILTER_TYPE_TypeDef)((i - 1) % 3 + 1) : FILTER_OFF;
+  Filter->Design = i > 3 ? FILTER_FIR : FILTER_IIR;
+  filter_design(Filter, Dso.Ts);
+  average_reset(Filter == &Filter1 ? &Average1 : &Average2);
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
+}
+
+
+void MainWindow::on_actionFilterCH1_triggered()
+{
+  SetFilter(&Filter1, "CH1 Filter");
+}
+
+
+void MainWindow::on_actionFilterCH2_triggered()
+{
+  SetFilter(&Filter2, "CH2 Filter");
+}
+
+
+// Acquire
+
+void MainWindow::on_actionHiResCH1_toggled(bool checked)
+{
+  Channel1.HiRes = checked;
+  average_reset(&Average1);
+}
+
+
+void MainWindow::on_actionHiResCH2_toggled(bool checked)
+{
+  Channel2.HiRes = checked;
+  average_reset(&Average2);
+}
+
+
+void MainWindow::SetAverage(DSO_AVERAGE* Average, const QString &label)
+{
+  static const QStringList types = QStringList()
+    << "Off" << "Linear" << "Exponential";
+  static const QStringList shots = QStringList()
+    << "2" << "4" << "8" << "16" << "32" << "64" << "128" << "256";
+
+  QString item;
+  bool ok;
+  int i;
+
+  item = QInputDialog::getItem
+    (this, label, "Averaging", types, Average->Type, false, &ok);
+  if(!ok) return;
+  i = types.indexOf(item);
+
+  if(i != AVERAGE_OFF)
+  {
+    item = QInputDialog::getItem
+    (
+      this, label, "Acquisitions", shots,
+      shots.indexOf(QString::number(Average->Shots)), false, &ok
+    );
+    if(!ok) return;
+    Average->Shots = item.toInt();
+  }
+  Average->Type = (AVERAGE_TYPE_TypeDef)i;
+  average_reset(Average);
 }
 
 
-void MainWindow::on_actionSetScaleFactor_triggered()
+void MainWindow::on_actionAverageCH1_triggered()
 {
-  // Insert code to set scale factor here.  Not sure whether calibrator output
-  // is reliably 2.00V p-p.  Currently use 1.5V cell, DVM and save trace.
-  write_cal_file();
+  SetAverage(&Average1, "CH1 Average");
 }
 
+
+void MainWindow::on_actionAverageCH2_triggered()
+{
+  SetAverage(&Average2, "CH2 Average");
+}
+
+
+void MainWindow::on_actionRoll_toggled(bool checked)      // slow timebases only
+{
+  Setup.Roll = checked;
+  ui->actionLog->setEnabled(checked);                   // logs what is streamed
+  if(!checked) ui->actionLog->setChecked(false);
+  axis_clear(&Axis);                   // triggered scans and strip chart differ
+  Publish(true);
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
+}
+
+
+void MainWindow::on_actionEts_toggled(bool checked)        // 500ns/div and less
+{
+  Setup.Ets = checked;
+  worker.EtsLock.lock();
+  ets_clear(&worker.Ets);                       // nothing from before it was on
+  worker.EtsLock.unlock();
+  axis_clear(&Axis);                // triggered scans and bins time differently
+  Publish(false);
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();
+}
+
+
+void MainWindow::on_actionLog_toggled(bool checked)  // statistics, see DSOlog.c
+{
+  static const HT6022_IRTypeDef range[LOG_RANGES] =
+    {HT6022_10V, HT6022_5V, HT6022_2V, HT6022_1V};
+
+  float volts[2][LOG_RANGES];                      // as vectorise() would scale
+  float zero[2][LOG_RANGES];
+  QString path;
+  double interval = LogInterval;
+  bool ok = false;
+  int r;
+  int c;
+
+  if(!checked)
+  {
+    if(!worker.Log.Data) return;                         // never opened: cancel
+    worker.LogLock.lock();
+    log_close(&worker.Log);
+    worker.LogLock.unlock();
+    ui->statusBar->showMessage("Log closed", 0);
+    return;
+  }
+
+  path = QFileDialog::getSaveFileName
+    (this, "Log to File", QDir::homePath(), "Logs (*.dsolog)");
+  if(!path.isEmpty())
+    interval = QInputDialog::getDouble
+      (this, "Log to File", "Seconds per record", interval, 0.1, 3600, 1, &ok);
+  if(!ok)
+  {
+    ui->actionLog->setChecked(false);
+    return;
+  }
+  LogInterval = interval;
+
+  for(r = 0; r < LOG_RANGES; r++)                  // as cal_channel() sets them
+    for(c = 0; c < 2; c++)
+    {
+      volts[c][r] = cal_nominal(cal_range(range[r])) /
+        Cal.Gain[c][cal_range(range[r])];
+      zero[c][r] = 128 + Cal.Offset[c][cal_range(range[r])];
+    }
+
+  worker.LogLock.lock();
+  ok = log_open
+  (
+    &worker.Log, path.toLocal8Bit().constData(), interval, Dso.Ts,
+    range, volts, zero
+  );
+  worker.LogLock.unlock();
+  if(!ok)
+  {
+    ui->statusBar->showMessage(QString("Cannot open ") + path, 0);
+    ui->actionLog->setChecked(false);
+  }
+  else ui->statusBar->showMessage(QString("Logging to ") + path, 0);
+}
+
+
+void MainWindow::on_actionLogSummary_triggered()      // over part of a log file
+{
+  LOG_SUMMARY s;
+  QString path;
+  QString text;
+  double from;
+  double to;
+  bool ok;
+  int ch;
+
+  path = QFileDialog::getOpenFileName
+    (this, "Log Summary", QDir::homePath(), "Logs (*.dsolog)");
+  if(path.isEmpty()) return;
+  from = QInputDialog::getDouble
+    (this, "Log Summary", "From (s)", 0, 0, 1e9, 1, &ok);
+  if(!ok) return;
+  to = QInputDialog::getDouble
+    (this, "Log Summary", "To (s)", 1e9, from, 1e9, 1, &ok);
+  if(!ok) return;
+
+  if(!log_query(path.toLocal8Bit().constData(), from, to, &s))
+  {
+    ui->statusBar->showMessage(QString("Not a log: ") + path, 0);
+    return;
+  }
+  if(!s.Records)
+    text = "No records in that range";
+  else
+  {
+    text = QString("%1 records, %2s to %3s\n")
+      .arg(s.Records).arg(s.From, 0, 'f', 1).arg(s.To, 0, 'f', 1);
+    for(ch = 0; ch < 2; ch++)
+      text += QString("\nCH%1: min %2V, max %3V, mean %4V")
+        .arg(ch + 1).arg(s.Min[ch], 0, 'f', 3).arg(s.Max[ch], 0, 'f', 3)
+        .arg(s.Mean[ch], 0, 'f', 4);
+  }
+  QMessageBox::information(this, "Log Summary", text);
+}
+
+
+void MainWindow::UpdateMask(bool force)   // rasterise again if settings moved
+{
+  static double last[7];
+  DSO_CHANNEL* Channel = Mask.Channel ? &Channel2 : &Channel1;
+  double now[7] =
+  {
+    Dso.Tdiv, Dso.Ts * Dso.SubSample, Channel->VScale, Channel->Vdiv,
+    Channel->VOffset, Channel->Zero, Channel->Inv ? -1.0 : 1.0
+  };
+  QVector<double> t;
+  QVector<double> v;
+  MASK_POLYGON* P;
+  int i;
+  int k;
+
+  if(!force && !memcmp(now, last, sizeof(now))) return;
+  memcpy(last, now, sizeof(now));
+
+  for(i = 0; i < MASK_POLYGONS; i++) vMask[i]->clearData();
+  if(!Mask.Enabled)
+  {
+    mask_withdraw(&Mask);
+    ui->customPlot->replot();
+    return;
+  }
+  mask_rasterise(&Mask, Channel);
+
+  if(Mask.Auto)                       // upper and lower edges of allowed band
+  {
+    for(i = 0; i < 2; i++)
+    {
+      t.clear(), v.clear();
+      for(k = 0; k < MASK_BAND; k++)
+        if(Mask.Hi[k] >= Mask.Lo[k])
+          t << k * Dso.Tdiv / 100, v << (i ? Mask.Lo[k] : Mask.Hi[k]) / 4;
+      vMask[i]->setBrush(Qt::NoBrush);
+      vMask[i]->setData(t, v);
+    }
+  }
+  else
+  {
+    for(i = 0; i < Mask.Polygons; i++)               // closed, filled outlines
+    {
+      P = &Mask.Polygon[i];
+      t.clear(), v.clear();
+      for(k = 0; k <= P->Count; k++)
+        t << P->t[k % P->Count] * Dso.Tdiv, v << P->v[k % P->Count] / 4;
+      vMask[i]->setBrush(QBrush(QColor(255, 0, 0, 60)));
+      vMask[i]->setData(t, v);
+    }
+  }
+  ui->customPlot->replot();
+}
+
+
+void MainWindow::on_actionMaskLoad_triggered()
+{
+  static const QStringList channels = QStringList() << "CH1" << "CH2";
+
+  QString path;
+  QString item;
+  bool ok;
+  int err;
+
+  path = QFileDialog::getOpenFileName
+    (this, "Load Mask", QDir::homePath(), "Mask files (*.msk *.txt)");
+  if(path.isEmpty()) return;
+
+  item = QInputDialog::getItem
+    (this, "Load Mask", "Test channel", channels, Mask.Channel, false, &ok);
+  if(!ok) return;
+
+  Mask.Enabled = false;                             // stop worker testing ...
+  mask_withdraw(&Mask);
+  Mask.Channel = channels.indexOf(item);
+  err = mask_load(&Mask, path.toLocal8Bit().constData());
+  if(err)
+    ui->statusBar->showMessage
+    (
+      err < 0 ? QString("Cannot open ") + path :
+      QString("Mask file error at line %1").arg(err), 0
+    );
+  UpdateMask(true);                             // ... until rasterised again
+}
+
+
+void MainWindow::SetMaskFromTrace(int channel)
+{
+  DSO_SET View;
+  double dt;
+  double dv;
+  bool ok;
+
+  if(Shown[0] == NULL) return;                       // no trace to take it from
+  settings_view(&View, &Dso, &Shown[0]->Settings);
+  dt = QInputDialog::getDouble
+    (this, "Mask from Trace", "Time tolerance (div)", 0.1, 0, 2, 2, &ok);
+  if(!ok) return;
+  dv = QInputDialog::getDouble
+    (this, "Mask from Trace", "Voltage tolerance (div)", 0.2, 0, 4, 2, &ok);
+  if(!ok) return;
+
+  Mask.Enabled = false;
+  mask_withdraw(&Mask);
+  mask_from_trace
+  (
+    &Mask, Shown[0]->Data, &View, Shown[0]->TriggerPoint,
+    channel ? &Channel2 : &Channel1, channel, dt, dv
+  );
+  UpdateMask(true);
+}
+
+
+void MainWindow::on_actionMaskCH1_triggered()
+{
+  SetMaskFromTrace(0);
+}
+
+
+void MainWindow::on_actionMaskCH2_triggered()
+{
+  SetMaskFromTrace(1);
+}
+
+
+void MainWindow::on_actionMaskClear_triggered()
+{
+  Mask.Enabled = false;
+  UpdateMask(true);
+  ui->statusBar->showMessage("Mask cleared",0);
+}
+
+
+void MainWindow::on_actionMaskStop_toggled(bool checked)
+{
+  Mask.StopOnFail = checked;
+}
+
+
+void MainWindow::on_actionMaskSave_toggled(bool checked)
+{
+  Mask.SaveOnFail = checked;                            // ~/maskfail_NNNN.csv
+}
+
+
+void MainWindow::on_actionMaskReset_triggered()
+{
+  mask_clear_counts(&Mask);
+}
+
+
+void MainWindow::SubmitDecode()        // threshold each new capture for decode
+{
+  static unsigned int frame;
+  DSO_FRAME* Frame = Shown[0];
+
+  if(Decode.Protocol == DECODE_OFF || Frame->Sequence == frame) return;
+  frame = Frame->Sequence;
+
+  DecodeLevels(Frame->Settings.Dso.Ts);              // as the capture was taken
+  Decode.Origin = Frame->TriggerPoint + Dso.TriggerDelay;
+  decoder.submit(Frame->Data, 0, Frame->Settings.Dso.MemDepth, true);
+}
+
+
+void MainWindow::DecodeLevels(double Ts)      // logic levels as codes, from now
+{
+  DSO_CHANNEL* Channel[2] = {&Channel1, &Channel2};
+  double code;
+  int i;
+
+  decoder.lock.lock();                        // the worker submits in roll mode
+  for(i = 0; i < 2; i++)
+  {
+    code = scale_code(Channel[i]->Scale, Decode.Threshold[i]);
+    Decode.Level[i] = code < 1 ? 1 : code > 255 ? 255 : (unsigned char)code;
+  }
+  Decode.Ts = Ts;
+  decoder.lock.unlock();
+}
+
+
+void MainWindow::onDecoded()          // label decoded words that are on screen
+{
+  static int shown;
+  DECODE_ANNOT* a;
+  char text[16];
+  double x;
+  double origin;                               // time of sample 0, as on screen
+  int n = 0;
+  int i;
+
+  decoder.lock.lock();
+  if(Setup.Roll)                     // newest sample streamed at the right edge
+    origin = 10 * Dso.Tdiv - Decode.Length * Decode.Ts;
+  else origin = -Decode.Origin * Decode.Ts - Dso.TriggerOffset;
+  for(i = 0; i < Decode.Annotations && n < DECODE_SHOWN; i++)
+  {
+    a = &Decode.Annot[i];
+    x = origin + (a->Start + a->End) / 2.0 * Decode.Ts;
+    if(x < 0 || x > 10 * Dso.Tdiv) continue;
+
+    switch(a->Type)
+    {
+      case ANNOT_START:
+        sprintf(text, "S");
+        break;
+      case ANNOT_STOP:
+        sprintf(text, "P");
+        break;
+      case ANNOT_ADDRESS:
+        sprintf(text, "%c:%02X", a->Flags & DECODE_READ ? 'R' : 'W', a->Value);
+        break;
+      default:
+        if(Decode.Protocol == DECODE_UART && a->Value >= ' ' && a->Value < 127)
+          sprintf(text, "'%c'", a->Value);
+        else sprintf(text, "%02X", a->Value);
+        break;
+    }
+    if(a->Flags & DECODE_NACK) strcat(text, " N");
+    if(a->Flags & (DECODE_PARITY | DECODE_FRAME)) strcat(text, " !");
+
+    vDecode[n]->position->setCoords(x, 0.9);
+    vDecode[n]->setText(text);
+    vDecode[n]->setColor(a->Flags ? Qt::red : Qt::white);
+    vDecode[n++]->setVisible(true);
+  }
+  decoder.lock.unlock();
+
+  for(i = n; i < shown; i++) vDecode[i]->setVisible(false);
+  if(n || shown) ui->customPlot->replot();
+  shown = n;
+}
+
+
+void MainWindow::on_actionDecode_triggered()
+{
+  static const QStringList protocols = QStringList()
+    << "Off" << "UART" << "I2C (CH1 SCL, CH2 SDA)"
+    << "SPI (CH1 clock, CH2 data)";
+  static const QStringList channels = QStringList() << "CH1" << "CH2";
+  static const QStringList parities = QStringList()
+    << "None" << "Even" << "Odd";
+  static const QStringList edges = QStringList() << "Rising" << "Falling";
+
+  QString item;
+  bool ok;
+  int i;
+
+  item = QInputDialog::getItem
+    (this, "Decode", "Protocol", protocols, Decode.Protocol, false, &ok);
+  if(!ok) return;
+  i = protocols.indexOf(item);
+
+  decoder.lock.lock();                        // nothing to decode meanwhile
+  Decode.Protocol = DECODE_OFF;
+  decode_reset(&Decode);
+  decoder.lock.unlock();
+  onDecoded();
+  if(i == DECODE_OFF) return;
+
+  if(i == DECODE_UART)
+  {
+    item = QInputDialog::getItem
+      (this, "UART", "Data channel", channels, Decode.Channel, false, &ok);
+    if(!ok) return;
+    Decode.Channel = channels.indexOf(item);
+    Decode.Baud = QInputDialog::getInt
+      (this, "UART", "Baud rate", (int)Decode.Baud, 50, 4000000, 1, &ok);
+    if(!ok) return;
+    Decode.DataBits = QInputDialog::getInt
+      (this, "UART", "Data bits", Decode.DataBits, 5, 9, 1, &ok);
+    if(!ok) return;
+    item = QInputDialog::getItem
+      (this, "UART", "Parity", parities, Decode.Parity, false, &ok);
+    if(!ok) return;
+    Decode.Parity = (DECODE_PARITY_TypeDef)parities.indexOf(item);
+  }
+  else if(i == DECODE_SPI)
+  {
+    item = QInputDialog::getItem
+    (
+      this, "SPI", "Data valid on clock edge", edges,
+      Decode.ClockFalling ? 1 : 0, false, &ok
+    );
+    if(!ok) return;
+    Decode.ClockFalling = edges.indexOf(item) == 1;
+    Decode.Gap = 1e-6 * QInputDialog::getDouble
+    (
+      this, "SPI", "Idle clock time ending a word (us)", Decode.Gap * 1e6,
+      0.1, 1e6, 1, &ok
+    );
+    if(!ok) return;
+  }
+
+  Decode.Threshold[0] = QInputDialog::getDouble
+    (this, "Decode", "CH1 threshold (V)", Decode.Threshold[0], -5, 5, 2, &ok);
+  if(!ok) return;
+  Decode.Threshold[1] = QInputDialog::getDouble
+    (this, "Decode", "CH2 threshold (V)", Decode.Threshold[1], -5, 5, 2, &ok);
+  if(!ok) return;
+
+  Decode.Protocol = (DECODE_PROTOCOL_TypeDef)i;
+  if(Dso.Status == STOP || Dso.Mode == SINGLE) updatePlot();   // decode held
+}
+
+
+// Reference
+
+int MainWindow::ChooseRef(const QString &title)           // REF1 to REF4, or -1
+{
+  QStringList refs;
+  QString item;
+  bool ok;
+  int i;
+
+  for(i = 0; i < REF_SLOTS; i++)
+    refs << QString("REF%1: %2").arg(i + 1)
+      .arg(Ref[i].Header ? Ref[i].Header->Name : "empty");
+  item = QInputDialog::getItem(this, title, "Reference", refs, 0, false, &ok);
+  return ok ? refs.indexOf(item) : -1;
+}
+
+
+bool MainWindow::LoadRef(int slot, const QString &path)    // shown, and kept so
+{
+  QElapsedTimer mapped;
+  QByteArray target;                              // library file, absolute path
+  char link[160];
+
+  mapped.start();
+  if(!ref_map(&Ref[slot], path.toLocal8Bit().constData()))
+  {
+    ui->statusBar->showMessage(QString("Cannot load ") + path, 0);
+    ShowRefs(true);                                         // slot is empty now
+    ui->customPlot->replot();
+    return false;
+  }
+  ui->statusBar->showMessage
+  (
+    QString("REF%1: %2, %3 samples, mapped in %4us")
+      .arg(slot + 1).arg(Ref[slot].Header->Name)
+      .arg(Ref[slot].Header->Samples).arg(mapped.nsecsElapsed() / 1000), 0
+  );
+  if(ref_slot(link, sizeof(link), slot))                // for the next start-up
+  {
+    target = QFileInfo(path).absoluteFilePath().toLocal8Bit();
+    unlink(link);
+    if(symlink(target.constData(), link) != 0)
+      ui->statusBar->showMessage
+      (
+        ui->statusBar->currentMessage() +
+        QString(", not kept as REF%1 for the next start").arg(slot + 1), 0
+      );
+  }
+  ShowRefs(true);
+  ui->customPlot->replot();
+  return true;
+}
+
+
+void MainWindow::ShowRefs(bool force)        // formatted afresh once view moves
+{
+  static double last[10];
+  double view[10] =
+  {
+    Dso.Tdiv, Dso.Ts, Dso.TriggerDelay * Dso.Ts + Dso.TriggerOffset,
+    Channel1.Vdiv, Channel1.VOffset, (double)Channel1.Enabled,
+    Channel2.Vdiv, Channel2.VOffset, (double)Channel2.Enabled,
+    (double)Setup.Roll
+  };
+  bool on;
+  int i;
+
+  if(!force && memcmp(view, last, sizeof(view)) == 0) return;
+  memcpy(last, view, sizeof(view));
+  for(i = 0; i < 2 * REF_SLOTS; i++)
+  {
+    on = !Setup.Roll && (i % 2 ? Channel2.Enabled : Channel1.Enabled);
+    if
+    (
+      on &&
+      ref_trace
+      (
+        &Ref[i / 2], i % 2, r_vec[i].data(), &RefAxis[i], &Dso,
+        i % 2 ? &Channel2 : &Channel1
+      )
+    ) vRef[i]->setData(&RefAxis[i], r_vec[i].data(), HT6022_1KB);
+    else vRef[i]->clearData();
+  }
+}
+
+
+void MainWindow::on_actionRefSave_triggered()      // whole capture behind trace
+{
+  DSO_SET View;
+  QString path;
+  char dir[128];
+  int slot;
+
+  if(Setup.Roll || Setup.Ets)
+  {
+    ui->statusBar->showMessage("Not a single capture: nothing to save", 0);
+    return;
+  }
+  if((slot = ChooseRef("Save Reference")) < 0) return;
+  ref_dir(dir, sizeof(dir));
+  path = QFileDialog::getSaveFileName
+    (this, "Save Reference", dir, "Reference files (*.ref)");
+  if(path.isEmpty()) return;
+  if(!path.endsWith(".ref")) path += ".ref";
+
+  if(Shown[0] == NULL)            // as now on screen: nothing since the dialogs
+  {
+    ui->statusBar->showMessage("No capture to save", 0);
+    return;
+  }
+  settings_view(&View, &Dso, &Shown[0]->Settings);
+  if
+  (
+    !ref_save
+    (
+      path.toLocal8Bit().constData(), Shown[0], &View, &Axis,
+      &Channel1, &Channel2, QFileInfo(path).baseName().toLocal8Bit().constData()
+    )
+  )
+  {
+    ui->statusBar->showMessage(QString("Cannot save ") + path, 0);
+    return;
+  }
+  LoadRef(slot, path);
+}
+
+
+void MainWindow::on_actionRefLoad_triggered()                // from the library
+{
+  QString path;
+  char dir[128];
+  int slot;
+
+  ref_dir(dir, sizeof(dir));
+  path = QFileDialog::getOpenFileName
+    (this, "Load Reference", dir, "Reference files (*.ref)");
+  if(path.isEmpty()) return;
+  if((slot = ChooseRef("Load Reference")) < 0) return;
+  LoadRef(slot, path);
+}
+
+
+void MainWindow::on_actionRefClear_triggered()      // file stays in the library
+{
+  char link[160];
+  int slot;
+
+  if((slot = ChooseRef("Clear Reference")) < 0) return;
+  ref_unmap(&Ref[slot]);
+  if(ref_slot(link, sizeof(link), slot)) unlink(link);
+  ShowRefs(true);
+  ui->customPlot->replot();
+}
+
+
+void MainWindow::PlotUnits(bool hide)        // merged view, aligned on triggers
+{
+  DSO_SET View;                              // timing to show each capture with
+  int i;
+  int k;
+
+  for(i = 1; i < DSO_UNITS; i++)
+  {
+    vTrace[2 + 2*i]->clearData();
+    vTrace[3 + 2*i]->clearData();
+    if(hide || !__atomic_load_n(&Unit[i]->Connected, __ATOMIC_ACQUIRE))
+      continue;                                    // unplugged, or not yet read
+    if(!TakeFrame(i)) continue;                       // nothing captured as yet
+    settings_view(&View, &Dso, &Shown[i]->Settings);
+    for(k = 0; k < 2; k++)                   // as now set, with its own offsets
+    {
+      AuxChannel[i-1][k] = k ? Channel2 : Channel1;
+      AuxChannel[i-1][k].Scale = &AuxScale[i-1][k];
+      cal_channel
+        (&AuxChannel[i-1][k], k, AuxOwnCal[i-1] ? &AuxCal[i-1] : &Cal);
+      scale_update(&AuxChannel[i-1][k]);
+    }
+    if
+    (
+      get_unit_waveforms
+      (
+        a_vec[2*i-2].data(),
+        a_vec[2*i-1].data(),
+        Shown[i],
+        &View,
+        &AuxChannel[i-1][0],
+        &AuxChannel[i-1][1]
+      ) < 0
+    ) continue;
+    if(Channel1.Enabled)
+      vTrace[2 + 2*i]->setData(&Axis, a_vec[2*i-2].data(), HT6022_1KB);
+    if(Channel2.Enabled)
+      vTrace[3 + 2*i]->setData(&Axis, a_vec[2*i-1].data(), HT6022_1KB);
+  }
+}
+
+
+void MainWindow::updateUnits()        // further units, invoked by their workers
+{                                   // unit 0, while connected, redraws them all
+  if(Setup.Roll || Dso.Status != RUN) return;
+  if(__atomic_load_n(&worker.Connected, __ATOMIC_ACQUIRE)) return;
+  PlotUnits(false);
+  ui->customPlot->replotTraces();
+}
+
+
+void MainWindow::RollPlot()                     // roll mode: as streamed so far
+{
+  int i;
+
+  for(i = 0; i < 2 + 2 * DSO_UNITS; i++) vTrace[i]->clearData();
+
+  worker.RollLock.lock();                     // worker adds to it between reads
+  get_roll_waveforms
+  (
+    y1_vec.data(), y2_vec.data(), &Axis, &worker.Roll, &Dso,
+    &Channel1, &Channel2
+  );
+  worker.RollLock.unlock();
+  if(Decode.Protocol != DECODE_OFF)              // worker submits each transfer
+  {
+    DecodeLevels(Dso.Ts);
+    onDecoded();                                 // labels scroll with the trace
+  }
+                           // single shot: edge rolled to mid screen, so stop
+  if(Dso.Mode == SINGLE && Dso.Status == RUN && worker.Triggered == Setup.Arm)
+  {
+    worker.blockSignals(1);
+    Dso.Status = STOP;
+    ui->btnGet->setText("ARM");
+  }
+
+  if(Channel1.Enabled)
+    vTrace[0]->setData(&Axis, y1_vec.data(), HT6022_1KB);
+  if(Channel2.Enabled)
+    vTrace[1]->setData(&Axis, y2_vec.data(), HT6022_1KB);
+
+  ui->customPlot->replotTraces();
+  ShowBuffers();
+}
+
+
+DSO_FRAME* MainWindow::TakeFrame(int unit)         // newest capture from a unit
+{
+  DSO_FRAME* f;
+
+  if(Dso.Status == RUN && (f = Unit[unit]->take()))     // stored trace: keep it
+  {
+    frame_release(Shown[unit]);             // back to the pool if not still ...
+    Shown[unit] = f;                                   // ... that unit's latest
+  }
+  return Shown[unit];
+}
+
+
+void MainWindow::ShowJitter()           // of trigger edges, as trigger tool tip
+{
+  static int shown = -1;
+  int ps = (int)(get_trigger_jitter() * 1e12 + 0.5);
+
+  if(ps == shown) return;                        // keep formatting off the path
+  shown = ps;
+  ui->labelTrigger->setToolTip
+  (
+    ps ? QString("Trigger jitter %1ps rms").arg(ps) : QString()
+  );
+}
+
+
+void MainWindow::ShowBuffers()        // transfer buffer use, as status tool tip
+{
+  FRAME_POOL_STATS s;
+  QString tip;
+  bool changed = false;
+  int i;
+
+  for(i = 0; i < DSO_UNITS; i++)
+  {
+    frame_pool_stats(&Unit[i]->Frames, &s);
+    changed |= memcmp(&s, &Buffers[i], sizeof(s)) != 0;
+    Buffers[i] = s;
+  }
+  if(!changed) return;                           // keep formatting off the path
+
+  for(i = 0; i < DSO_UNITS; i++)
+  {
+    s = Buffers[i];
+    if(!s.Allocs) continue;                                // never had a device
+    if(!tip.isEmpty()) tip += "\n";
+    tip += QString
+    (
+      "Unit %1: %2 of %3 buffers held, %4KB; %5 USB, %6 hugepage, "
+      "%7 paged, %8 locked; %9 allocations"
+    )
+      .arg(i + 1).arg(s.Held).arg(s.Frames).arg(s.Bytes / 1024)
+      .arg(s.Mem[FRAME_MEM_USB])
+      .arg(s.Mem[FRAME_MEM_HUGETLB] + s.Mem[FRAME_MEM_THP])
+      .arg(s.Mem[FRAME_MEM_PAGES]).arg(s.Locked).arg(s.Allocs);
+    if(s.Fallbacks) tip += QString(", %1 options refused").arg(s.Fallbacks);
+    if(s.Waits) tip += QString(", %1 waits").arg(s.Waits);
+  }
+  ui->statusBar->setToolTip(tip);
+}
+
+
+void MainWindow::ApplySR(HT6022_SRTypeDef SR)     // queued for every 'scope ...
+{
+  if(SR == Setup.SR) return;                // ... and set by each between reads
+  Setup.SR = SR;
+  Setup.Config++;
+  Switch.start();
+  Switching = Dso.Status == RUN;                  // stored traces are not timed
+  Publish(false);
+}
+
+
+void MainWindow::ApplyIR(int channel, HT6022_IRTypeDef IR)
+{
+  if(IR == Setup.IR[channel]) return;
+  Setup.IR[channel] = IR;
+  Setup.Config++;
+  Switch.start();
+  Switching = Dso.Status == RUN;                  // stored traces are not timed
+  Publish(false);
+}
+
+
+void MainWindow::onDeviceArrived(HT6022_DeviceTypeDef Found)  // give to unit
+{
+  HT6022_DeviceTypeDef* Device;
+  int i;
+
+  for(i = 0; i < DSO_UNITS; i++)               // first free unit, worker first
+    if(!Unit[i]->Device->DeviceHandle) break;
+  if(i == DSO_UNITS)
+  {
+    HT6022_DeviceClose(&Found);                             // no room for it
+    return;
+  }
+
+  Device = Unit[i]->Device;
+  Unit[i]->DeviceLock.lock();
+  *Device = Found;
+  Unit[i]->Configured = false;             // worker restores SR and IR settings
+  Unit[i]->DeviceLock.unlock();
+  device.units++;
+
+  ui->statusBar->showMessage(QString("Device %1 initialized.").arg(i + 1),0);
+  if(i) AuxOwnCal[i - 1] = false;        // EEPROM read only on request, if ever
+  if(i == 0)
+  {
+    ArrivalFrame = worker.Frame;
+    FirstFrame = true;
+    OpenTime = Startup.elapsed();                  // shown with the first frame
+  }
+}
+
+
+void MainWindow::onDeviceLost(int unit)      // unit resumes when one arrives
+{
+  if(!Unit[unit]->Device->DeviceHandle) return;
+  Unit[unit]->DeviceLock.lock();
+  HT6022_DeviceClose(Unit[unit]->Device);
+  Unit[unit]->DeviceLock.unlock();
+  device.units--;
+  if(unit == 0)
+  {
+    Startup.start();                       // time to first frame on return
+    FirstFrame = false;
+  }
+  ui->statusBar->showMessage
+    (QString("Device %1 disconnected, waiting...").arg(unit + 1),0);
+}
+
+
+void MainWindow::onDeviceUnplugged(int address)
+{
+  int i;
+
+  for(i = 0; i < DSO_UNITS; i++)
+    if(Unit[i]->Device->DeviceHandle && Unit[i]->Device->Address == address)
+      onDeviceLost(i);
+}
+
+
+// Session
+
+void MainWindow::TakeSession(SESSION* Session)     // controls as they now stand
+{
+  DSO_FILTER* Filter;
+  DSO_AVERAGE* Average;
+  int i;
+
+  memset(Session, 0, sizeof(*Session));   // so unchanged settings compare equal
+  Session->Sampling = ui->comboSampling->currentIndex();
+  Session->Range[0] = ui->comboBoxV1div->currentIndex();
+  Session->Range[1] = ui->comboBoxV2div->currentIndex();
+  Session->VarMode[0] = VarCH1;
+  Session->VarMode[1] = VarCH2;
+  Session->Cursor[0] = ui->dialCursorV1->value();
+  Session->Cursor[1] = ui->dialCursorV2->value();
+  Session->Trigger = ui->dialTrigger->value();
+  Session->Delay = ui->dialDelay->value();
+  Session->Mode = ui->comboBox_4->currentIndex();
+  Session->Dots = ui->actionDots->isChecked();
+  Session->Raster = ui->actionRaster->isChecked();
+  Session->Dso = Dso;
+  Session->Setup = Setup;
+  Session->Setup.Version = 0;                    // published again, not changed
+  Session->Setup.Arm = 0;
+  Session->Channel[0] = Channel1;
+  Session->Channel[1] = Channel2;
+  for(i = 0; i < 2; i++)
+  {
+    Session->Channel[i].Filter = NULL;                  // as set up at start-up
+    Session->Channel[i].Average = NULL;
+    Session->Channel[i].Scale = NULL;
+    Filter = i ? &Filter2 : &Filter1;
+    Session->Filter[i].Type = Filter->Type;
+    Session->Filter[i].Design = Filter->Design;
+    Session->Filter[i].Fc = Filter->Fc;
+    Session->Filter[i].Q = Filter->Q;
+    Session->Filter[i].Order = Filter->Order;
+    Average = i ? &Average2 : &Average1;
+    Session->Average[i].Type = Average->Type;
+    Session->Average[i].Shots = Average->Shots;
+  }
+}
+
+
+void MainWindow::SaveSession()          // in background, should anything change
+{
+  SESSION s;
+  DSO_FRAME* Frame = NULL;
+
+  TakeSession(&s);
+  if(Dso.Status == STOP && !Setup.Roll && Shown[0])    // capture held on screen
+  {
+    Frame = Shown[0];
+    s.Capture = Frame->Settings;
+    s.TriggerPoint = Frame->TriggerPoint;
+    s.Sequence = Frame->Sequence;
+    s.Bytes = 2 * Frame->Settings.Dso.MemDepth;
+  }
+  if(memcmp(&s, &Saved, sizeof(s)) == 0) return;                   // as on disk
+  Saved = s;
+  session.submit(&s, Frame);
+}
+
+
+bool MainWindow::RestoreSession()        // controls as last left, before device
+{
+  DSO_FILTER* Filter;
+  DSO_AVERAGE* Average;
+  SESSION s;
+  char path[128];
+  char valueStr[10];
+  int i;
+
+  if(!session_path(path, sizeof(path)) || !session_read(path, &s))
+    return false;
+  if(s.Sampling < 0 || s.Sampling > TDIV_100S) return false;
+
+  Dso = s.Dso;                         // timing and delay, as for that timebase
+  Dso.Status = STOP;                                      // running again below
+  ui->comboSampling->setCurrentIndex(s.Sampling);
+
+  ui->comboBoxV1div->setCurrentIndex(s.Range[0]);
+  ui->comboBoxV2div->setCurrentIndex(s.Range[1]);
+  Channel1.VOffset = s.Channel[0].VOffset;       // dials show only one of these
+  Channel1.Vdiv = s.Channel[0].Vdiv;
+  Channel2.VOffset = s.Channel[1].VOffset;
+  Channel2.Vdiv = s.Channel[1].Vdiv;
+  ui->dialCursorV1->blockSignals(true);
+  ui->dialCursorV1->setValue(s.Cursor[0]);
+  ui->dialCursorV1->blockSignals(false);
+  ui->dialCursorV2->blockSignals(true);
+  ui->dialCursorV2->setValue(s.Cursor[1]);
+  ui->dialCursorV2->blockSignals(false);
+  ui->comboBoxMode1->setCurrentIndex(s.VarMode[0]);
+  on_comboBoxMode1_currentIndexChanged(s.VarMode[0]);           // and its label
+  ui->comboBoxMode2->setCurrentIndex(s.VarMode[1]);
+  on_comboBoxMode2_currentIndexChanged(s.VarMode[1]);
+
+  ui->comboBoxCHSel->setCurrentIndex(s.Dso.ChTrigger - 1);
+  ui->comboBox_rise->setCurrentIndex(s.Setup.TriggerEdge ? 0 : 1);
+  ui->dialTrigger->blockSignals(true);
+  ui->dialTrigger->setValue(s.Trigger);
+  ui->dialTrigger->blockSignals(false);
+  on_dialTrigger_valueChanged(s.Trigger);                // level for this range
+  ui->dialHoldoff->blockSignals(true);
+  ui->dialHoldoff->setValue(s.Setup.Holdoff);
+  ui->dialHoldoff->blockSignals(false);
+  on_dialHoldoff_valueChanged(s.Setup.Holdoff);
+  ui->dialDelay->blockSignals(true);
+  ui->dialDelay->setValue(s.Delay);             // its turns so far are not kept
+  ui->dialDelay->blockSignals(false);
+  float2engStr(valueStr, Dso.TriggerDelay * Dso.Ts + Dso.TriggerOffset);
+  ui->lblfreq->setText(valueStr);
+
+  ui->checkBoxCH1ON->setChecked(s.Channel[0].Enabled);
+  ui->checkBoxCH2ON->setChecked(s.Channel[1].Enabled);
+  ui->checkBoxCH1Inv->setChecked(s.Channel[0].Inv);
+  ui->checkBoxCH2Inv->setChecked(s.Channel[1].Inv);
+  ui->checkBoxCH1Glitch->setChecked(s.Channel[0].Glitch);
+  ui->checkBoxCH2Glitch->setChecked(s.Channel[1].Glitch);
+  ui->checkBoxCH1Add->setChecked(s.Dso.ChAdd != 0);
+  ui->actionHiResCH1->setChecked(s.Channel[0].HiRes);
+  ui->actionHiResCH2->setChecked(s.Channel[1].HiRes);
+  for(i = 0; i < 2; i++)
+  {
+    Filter = i ? &Filter2 : &Filter1;
+    Filter->Type = s.Filter[i].Type;
+    Filter->Design = s.Filter[i].Design;
+    Filter->Fc = s.Filter[i].Fc;
+    Filter->Q = s.Filter[i].Q;
+    Filter->Order = s.Filter[i].Order;
+    filter_design(Filter, Dso.Ts);
+    Average = i ? &Average2 : &Average1;
+    Average->Type = s.Average[i].Type;
+    Average->Shots = s.Average[i].Shots;
+    average_reset(Average);
+  }
+
+  ui->actionDots->setChecked(s.Dots);
+  ui->actionRaster->setChecked(s.Raster);
+  if(ui->actionRoll->isEnabled()) ui->actionRoll->setChecked(s.Setup.Roll);
+  if(ui->actionEts->isEnabled()) ui->actionEts->setChecked(s.Setup.Ets);
+
+  ui->comboBox_4->blockSignals(true);         // selecting it would set it going
+  ui->comboBox_4->setCurrentIndex(s.Mode);
+  ui->comboBox_4->blockSignals(false);
+  if(s.Dso.Status == RUN) on_comboBox_4_currentIndexChanged(s.Mode);
+  else Publish(true);
+
+  TakeSession(&Saved);                            // nothing new to write as yet
+  if(Dso.Status == STOP && s.Bytes)        // read once the window is up, so ...
+  {
+    Restoring = s;                          // ... it never holds up device open
+    QTimer::singleShot(0, this, SLOT(RestoreCapture()));
+  }
+  return true;
+}
+
+
+void MainWindow::RestoreCapture()                // stored trace as at last exit
+{
+  QElapsedTimer restore;
+  char path[128];
+
+  restore.start();
+  if(Shown[0] || Dso.Status != STOP) return;                 // moved on already
+  if(Restoring.Bytes > (int)sizeof(RestoredData)) return;
+  if
+  (
+    !session_path(path, sizeof(path)) ||
+    !session_read_capture(path, &Restoring, RestoredData)
+  ) return;
+
+  memset(&Restored, 0, sizeof(Restored));
+  Restored.Data = RestoredData;
+  Restored.Size = Restoring.Bytes;
+  Restored.Refs = 1;                           // held by Shown[0], from no pool
+  Restored.Settings = Restoring.Capture;
+  Restored.TriggerPoint = Restoring.TriggerPoint;
+  Restored.Sequence = Restoring.Sequence;
+  Shown[0] = &Restored;
+
+  Saved.Capture = Restoring.Capture;                            // as is on disk
+  Saved.TriggerPoint = Restoring.TriggerPoint;
+  Saved.Sequence = Restoring.Sequence;
+  Saved.Bytes = Restoring.Bytes;
+
+  ui->actionSave_to_file->setEnabled(true);
+  updatePlot();
+  RestoreTime += restore.elapsed();
+}
@@ -26,7 +26,13 @@
 
 #include <QMainWindow>
 #include "qcustomplot.h"
+#include "trace.h"
 #include "dso.h"
+#include "DSOfilter.h"
+#include "DSOaverage.h"
+#include "DSOframe.h"
+#include "DSOsession.h"
+#include "DSOref.h"
 
 namespace Ui {
 class MainWindow;
@@ -47,6 +53,8 @@ private slots:
 
     void updatePlot();
 
+    void updateUnits();
+
     void on_comboSampling_currentIndexChanged(int index);
 
     void on_dialTrigger_valueChanged(int value);
@@ -99,10 +107,109 @@ private slots:
 
     void SetTriggerLine(DSO_CHANNEL* Channel);
 
-    void on_actionSetScaleFactor_triggered(void);
+    void on_actionGain_Cal_triggered();
+
+    void on_actionBenchmark_triggered();
+
+    void on_actionTriggerTest_triggered();
+
+    void on_actionJitterTest_triggered();
+
+    void on_actionCalTest_triggered();
+
+    void on_actionCalRead_triggered();
+
+    void on_actionDots_toggled(bool checked);
+
+    void on_actionRaster_toggled(bool checked);
+
+    void on_actionMath1_triggered();
+
+    void on_actionMath2_triggered();
+
+    void on_actionFilterCH1_triggered();
+
+    void on_actionFilterCH2_triggered();
+
+    void on_actionHiResCH1_toggled(bool checked);
+
+    void on_actionHiResCH2_toggled(bool checked);
+
+    void on_actionAverageCH1_triggered();
+
+    void on_actionAverageCH2_triggered();
+
+    void on_actionRoll_toggled(bool checked);
+
+    void on_actionEts_toggled(bool checked);
+
+    void on_actionLog_toggled(bool checked);
+
+    void on_actionLogSummary_triggered();
+
+    void on_actionMaskLoad_triggered();
+
+    void on_actionMaskCH1_triggered();
+
+    void on_actionMaskCH2_triggered();
+
+    void on_actionMaskClear_triggered();
+
+    void on_actionMaskStop_toggled(bool checked);
+
+    void on_actionMaskSave_toggled(bool checked);
+
+    void on_actionMaskReset_triggered();
+
+    void on_actionDecode_triggered();
+
+    void on_actionRefSave_triggered();
+
+    void on_actionRefLoad_triggered();
+
+    void on_actionRefClear_triggered();
+
+    void onDecoded();
+
+    void onDeviceArrived(HT6022_DeviceTypeDef Found);
+
+    void onDeviceLost(int unit);
+
+    void onDeviceUnplugged(int address);
+
+    void SaveSession();
+
+    void RestoreCapture();
+
+    void StoreCal();
 
 private:
     Ui::MainWindow *ui;
+    void SetMath(int trace);
+    void SetFilter(DSO_FILTER* Filter, const QString &label);
+    void SetAverage(DSO_AVERAGE* Average, const QString &label);
+    void SetMaskFromTrace(int channel);
+    void UpdateMask(bool force);
+    void SubmitDecode();
+    void DecodeLevels(double Ts);
+    void ApplySR(HT6022_SRTypeDef SR);
+    void ApplyIR(int channel, HT6022_IRTypeDef IR);
+    void Publish(bool arm);
+    DSO_FRAME* TakeFrame(int unit);
+    void PlotUnits(bool hide);
+    void RollPlot();
+    void ShowJitter();
+    void ShowBuffers();
+    void TakeSession(SESSION* Session);
+    bool RestoreSession();
+    int ChooseRef(const QString &title);
+    bool LoadRef(int slot, const QString &path);
+    void ShowRefs(bool force);
+    void LoadCal();
+    void ApplyCal();
+    void StartCal(bool gain, double volts);
+    void Calibration(DSO_FRAME* Frame);
+    QString ReadCalDevice(int unit);
 };
 
 #endif                                                           // MAINWINDOW_H
@@ -0,0 +1,80 @@
+/*
+  session.cpp: Background thread saving the session, see DSOsession.c.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  Writing a 2MB capture and waiting for it to reach the disk can take a
+  good part of a second, so the GUI hands over a copy of the settings and
+  a reference to the frame on screen, and carries on.  Only the latest
+  submission is kept: should several arrive during one write, those in
+  between are dropped and their frames released.  The last one submitted
+  is still written once alive is cleared, so nothing is lost on exit.
+*/
+
+
+#include "session.h"
+
+
+void sessionThread::submit
+(
+  const SESSION* Session,
+  DSO_FRAME* Capture                            // Session->Bytes of it, or NULL
+)
+{
+  if(Capture) frame_retain(Capture);              // not back to pool till saved
+  lock.lock();
+  frame_release(Frame);                             // superseded before written
+  Next = *Session;
+  Frame = Capture;
+  more = true;
+  pending.wakeOne();
+  lock.unlock();
+}
+
+
+void sessionThread::run()
+{
+  SESSION Session;
+  DSO_FRAME* Capture;
+  char path[128];
+  bool ok;
+
+  if(!session_path(path, sizeof(path))) path[0] = 0;          // nowhere to save
+
+  while(alive || more)
+  {
+    lock.lock();
+    if(!more) pending.wait(&lock, 100);         // wake regularly to check alive
+    if(!more)
+    {
+      lock.unlock();
+      continue;
+    }
+    Session = Next;
+    Capture = Frame;
+    Frame = NULL;
+    more = false;
+    lock.unlock();
+
+    ok =
+      path[0] &&
+      session_write(path, &Session, Capture ? Capture->Data : NULL);
+    frame_release(Capture);
+    if(ok) Writes++;
+    else Failures++;
+  }
+}
@@ -0,0 +1,50 @@
+/*
+  session.h
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SESSION_H
+#define SESSION_H
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include "DSOsession.h"
+#include "DSOframe.h"
+
+class sessionThread : public QThread
+{
+    Q_OBJECT
+public:
+    int alive;                                         // for thread termination
+    int Writes;                                       // sessions saved, and ...
+    int Failures;                                     // ... those that were not
+    void submit                              // write in background, latest only
+    (
+      const SESSION* Session,
+      DSO_FRAME* Capture                      // retained until written, or NULL
+    );
+private:
+    QMutex lock;
+    QWaitCondition pending;
+    SESSION Next;
+    DSO_FRAME* Frame;                                    // NULL if none to save
+    bool more;                                           // Next not yet written
+    void run();
+};
+
+#endif                                                              // SESSION_H
@@ -0,0 +1,333 @@
+/*
+  trace.cpp: waveform trace plottable, drawn straight from the formatted
+  single precision traces.
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+  QCPGraph copies every point into a QMap of double precision QCPData,
+  each a heap node with error bars, on every frame only to sort them by
+  time.  This reads the caller's arrays where they lie when it is drawn.
+  Times are not stored at all: each span of a trace is uniformly sampled,
+  point i at t0 + i * dt, so with linear axes the pixel position is just
+  as simple a function of i.  On the fastest timebases the trace is a
+  composite of spans from several scans whose times interleave; these are
+  merged into time order as they are drawn.
+
+  tracePlot keeps the graticule, axes, cursors, mask and labels as they
+  were last drawn in an image.  Each new frame only changes the traces, so
+  replotTraces() copies that image and draws the traces, which sit on a
+  layer of their own above everything else, straight over it.  A full
+  replot(), an axis range change or invalidate() draws the rest afresh.
+
+  QPainter then strokes each trace as an antialiased polyline, which costs
+  far more than the data it shows.  Unless Raster is cleared the traces are
+  written into the copy directly by raster_trace(), see DSOraster.c, and
+  the result blitted as one image.
+*/
+
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include "trace.h"
+#include "DSOraster.h"
+
+
+traceGraph::traceGraph(QCPAxis* keyAxis, QCPAxis* valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  Axis(0),
+  Value(0),
+  Count(0),
+  Dots(false)
+{
+}
+
+
+void traceGraph::setData(const DSO_AXIS* axis, const float* value, int n)
+{
+  Axis = axis;
+  Value = value;
+  Count = n;
+}
+
+
+void traceGraph::clearData()
+{
+  Count = 0;
+}
+
+
+void traceGraph::paint(QCPPainter* painter, bool dots)
+{
+  Dots = dots;
+  painter->save();
+  painter->setClipRect(clipRect().translated(0, -1));
+  applyDefaultAntialiasingHint(painter);
+  draw(painter);
+  painter->restore();
+}
+
+
+double traceGraph::selectTest(const QPointF &, bool, QVariant*) const
+{
+  return -1;                                        // traces are not selectable
+}
+
+
+void traceGraph::rasterise(QImage* image, bool dots)
+{
+  QRect r = clipRect().translated(0, -1) & image->rect();
+  RASTER_IMAGE Image;
+  unsigned char pattern;
+  int n;
+
+  if(!mKeyAxis || !mValueAxis || r.isEmpty()) return;
+  if(mainPen().style() == Qt::NoPen) return;
+
+  switch(mainPen().style())            // dashes as runs of columns out of eight
+  {
+    case Qt::DashLine: pattern = RASTER_DASH; break;
+    case Qt::DotLine: pattern = RASTER_DOT; break;
+    case Qt::DashDotLine: pattern = RASTER_DASHDOT; break;
+    default: pattern = RASTER_SOLID; break;
+  }
+  n = points(r.left() - 0.5f, r.top());      // columns cover x - 0.5 to x + 0.5
+  Image.Bits = (uint32_t*)image->scanLine(r.top()) + r.left();
+  Image.Stride = image->bytesPerLine() / sizeof(uint32_t);
+  Image.Width = r.width();
+  Image.Height = r.height();
+  raster_trace
+  (
+    &Image, X.constData(), Y.constData(), n,
+    mainPen().color().rgb(), pattern, dots
+  );
+}
+
+
+int traceGraph::points(float left, float top)   // visible points, in time order
+{
+  QCPAxis* keyAxis = mKeyAxis.data();
+  QCPAxis* valueAxis = mValueAxis.data();
+  QCPRange range;
+  int from[DSO_SPANS];                            // visible points of each span
+  int to[DSO_SPANS];
+  double x0[DSO_SPANS];                                  // pixel of point 0 ...
+  double dx;                                              // ... and from one on
+  double y0;
+  double dy;
+  double dt;
+  double t;
+  double lo;
+  double hi;
+  int first;
+  int end;
+  int n;
+  int s;
+  int k;
+  int i;
+
+  if(!keyAxis || !valueAxis || !Axis || !Count || !Axis->Spans) return 0;
+
+  range = keyAxis->range();
+  dt = Axis->dt;
+  dx = keyAxis->coordToPixel(dt) - keyAxis->coordToPixel(0);
+  y0 = valueAxis->coordToPixel(0) - top;
+  dy = valueAxis->coordToPixel(1) - top - y0;
+  for(s = 0, n = 0; s < Axis->Spans; s++)   // plus one point beyond either edge
+  {
+    t = Axis->Span[s].t0;
+    first = Axis->Span[s].First;
+    end = qMin(Axis->Span[s].End, Count);
+    lo = floor((range.lower - t) / dt);             // clamped before conversion
+    hi = ceil((range.upper - t) / dt) + 1;
+    from[s] = lo <= first ? first : lo >= end ? end : (int)lo;
+    to[s] = hi <= first ? first : hi >= end ? end : (int)hi;
+    x0[s] = keyAxis->coordToPixel(t) - left;
+    if(to[s] > from[s]) n += to[s] - from[s];
+  }
+  X.resize(n);
+  Y.resize(n);
+
+  if(Axis->Spans == 1)                           // usual case, straight through
+    for(i = from[0], n = 0; i < to[0]; i++, n++)
+    {
+      X[n] = x0[0] + dx * i;
+      Y[n] = y0 + dy * Value[i];
+    }
+  else
+    for(n = 0; n < X.size(); n++)                   // merge spans in time order
+    {
+      for(s = 0, k = -1; s < Axis->Spans; s++)
+        if
+        (
+          from[s] < to[s] && (k < 0 ||
+          Axis->Span[s].t0 + from[s] * dt < Axis->Span[k].t0 + from[k] * dt)
+        ) k = s;
+      i = from[k]++;
+      X[n] = x0[k] + dx * i;
+      Y[n] = y0 + dy * Value[i];
+    }
+  return n;
+}
+
+
+void traceGraph::draw(QCPPainter* painter)
+{
+  int n;
+  int i;
+
+  if(mainPen().style() == Qt::NoPen) return;
+  n = points(0, 0);
+  if(n < (Dots ? 1 : 2)) return;
+  Line.resize(n);
+  for(i = 0; i < n; i++) Line[i] = QPointF(X[i], Y[i]);
+
+  applyDefaultAntialiasingHint(painter);
+  painter->setPen(mainPen());
+  painter->setBrush(Qt::NoBrush);
+  if(Dots) painter->drawPoints(Line.constData(), n);
+  else painter->drawPolyline(Line.constData(), n);
+}
+
+
+void traceGraph::drawLegendIcon(QCPPainter* painter, const QRectF &rect) const
+{
+  applyDefaultAntialiasingHint(painter);
+  painter->setPen(mPen);
+  painter->drawLine
+  (
+    QLineF(rect.left(), rect.center().y(), rect.right(), rect.center().y())
+  );
+}
+
+
+QCPRange traceGraph::getKeyRange
+  (bool &foundRange, SignDomain inSignDomain) const
+{
+  QCPRange r(DBL_MAX, -DBL_MAX);
+  double t;
+  int s;
+  int i;
+
+  foundRange = false;
+  for(s = 0; Axis && Count && s < Axis->Spans; s++)
+    for(i = Axis->Span[s].First; i < qMin(Axis->Span[s].End, Count); i++)
+    {
+      t = Axis->Span[s].t0 + i * Axis->dt;
+      if(inSignDomain == sdNegative && t >= 0) continue;
+      if(inSignDomain == sdPositive && t <= 0) continue;
+      r.lower = qMin(r.lower, t);
+      r.upper = qMax(r.upper, t);
+      foundRange = true;
+    }
+  return foundRange ? r : QCPRange();
+}
+
+
+QCPRange traceGraph::getValueRange
+  (bool &foundRange, SignDomain inSignDomain) const
+{
+  QCPRange r(DBL_MAX, -DBL_MAX);
+  int s;
+  int i;
+
+  foundRange = false;
+  for(s = 0; Axis && Count && s < Axis->Spans; s++)
+    for(i = Axis->Span[s].First; i < qMin(Axis->Span[s].End, Count); i++)
+    {
+      if(inSignDomain == sdNegative && Value[i] >= 0) continue;
+      if(inSignDomain == sdPositive && Value[i] <= 0) continue;
+      r.lower = qMin(r.lower, (double)Value[i]);
+      r.upper = qMax(r.upper, (double)Value[i]);
+      foundRange = true;
+    }
+  return foundRange ? r : QCPRange();
+}
+
+
+tracePlot::tracePlot(QWidget* parent) :
+  QCustomPlot(parent),
+  Dots(false),
+  Raster(true),
+  Stale(true),
+  TracesOnly(false)
+{
+  addLayer("traces", layer("legend"), limAbove);
+  Traces = layer("traces");
+  connect(xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(invalidate()));
+  connect(yAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(invalidate()));
+}
+
+
+void tracePlot::invalidate()
+{
+  Stale = true;
+}
+
+
+void tracePlot::replotTraces()
+{
+  TracesOnly = !Stale;
+  replot();
+  TracesOnly = false;
+}
+
+
+void tracePlot::draw(QCPPainter* painter)
+{
+  QCPPainter p;
+  traceGraph* t;
+
+  if(!TracesOnly || Static.size() != mPaintBuffer.size())
+  {                                          // as replot() would but for Traces
+    Static = QImage(mPaintBuffer.size(), QImage::Format_ARGB32_Premultiplied);
+    Static.fill
+    (
+      mBackgroundBrush.style() == Qt::SolidPattern ?
+        mBackgroundBrush.color() : Qt::transparent
+    );
+    p.begin(&Static);
+    p.setRenderHint(QPainter::HighQualityAntialiasing);
+    if
+    (
+      mBackgroundBrush.style() != Qt::SolidPattern &&
+      mBackgroundBrush.style() != Qt::NoBrush
+    ) p.fillRect(mViewport, mBackgroundBrush);
+    Traces->setVisible(false);
+    QCustomPlot::draw(&p);
+    Traces->setVisible(true);
+    p.end();
+    Stale = false;
+  }
+
+  if(!Raster)
+  {
+    painter->drawImage(0, 0, Static);
+    foreach(QCPLayerable* child, Traces->children())
+      if((t = qobject_cast<traceGraph*>(child)) && t->realVisibility())
+        t->paint(painter, Dots);
+    return;
+  }
+
+  if(Frame.size() != Static.size() || Frame.format() != Static.format())
+    Frame = QImage(Static.size(), Static.format());
+  memcpy(Frame.bits(), Static.constBits(), Static.byteCount());    // no realloc
+  foreach(QCPLayerable* child, Traces->children())
+    if((t = qobject_cast<traceGraph*>(child)) && t->realVisibility())
+      t->rasterise(&Frame, Dots);
+  painter->drawImage(0, 0, Frame);
+}
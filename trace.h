@@ -0,0 +1,86 @@
+/*
+  trace.h
+
+  Copyright (C) 2018 P G Duesbury
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <QVector>
+#include <QPointF>
+#include <QImage>
+#include "qcustomplot.h"
+#include "dso.h"
+
+class traceGraph : public QCPAbstractPlottable
+{
+    Q_OBJECT
+public:
+    traceGraph(QCPAxis* keyAxis, QCPAxis* valueAxis);
+    void setData                    // drawn from where they lie, kept by caller
+    (
+      const DSO_AXIS* axis,
+      const float* value,
+      int n
+    );
+    virtual void clearData();
+    void paint(QCPPainter* painter, bool dots);      // as QCustomPlot would ...
+    void rasterise(QImage* image, bool dots);      // ... or straight into image
+    virtual double selectTest
+    (
+      const QPointF &pos,
+      bool onlySelectable,
+      QVariant* details = 0
+    ) const;
+protected:
+    virtual void draw(QCPPainter* painter);
+    virtual void drawLegendIcon(QCPPainter* painter, const QRectF &rect) const;
+    virtual QCPRange getKeyRange
+      (bool &foundRange, SignDomain inSignDomain = sdBoth) const;
+    virtual QCPRange getValueRange
+      (bool &foundRange, SignDomain inSignDomain = sdBoth) const;
+private:
+    int points(float left, float top);        // into X[] and Y[], from left top
+    const DSO_AXIS* Axis;                             // time of each of Value[]
+    const float* Value;                                     // display divisions
+    int Count;
+    bool Dots;                                        // points only, not joined
+    QVector<float> X;                               // in pixels, kept for reuse
+    QVector<float> Y;
+    QVector<QPointF> Line;
+};
+
+class tracePlot : public QCustomPlot
+{
+    Q_OBJECT
+public:
+    explicit tracePlot(QWidget* parent = 0);
+    QCPLayer* Traces;                      // "traces", on top: traceGraphs only
+    void replotTraces();                // only traces changed since last replot
+    Q_SLOT void invalidate();        // anything else changed without a replot()
+    bool Dots;                         // each point alone, as sampled: no lines
+    bool Raster;                 // traces drawn by raster_trace(), not QPainter
+protected:
+    virtual void draw(QCPPainter* painter);
+private:
+    QImage Static;                       // all layers but Traces, as last drawn
+    QImage Frame;                                      // Static plus the traces
+    bool Stale;                                        // Static needs redrawing
+    bool TracesOnly;                               // draw() is for replotTraces
+};
+
+#endif                                                                // TRACE_H
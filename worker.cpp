@@ -22,73 +22,271 @@
 
 
 #include <stdbool.h>
+#include <QElapsedTimer>
 #include "worker.h"
 #include "HT6022.h"
 #include "dso.h"
+#include "DSOmask.h"
+#include "DSOsettings.h"
+#include "DSOframe.h"
+#include "DSOroll.h"
+#include "DSOlog.h"
+#include "DSOtrigger.h"
+#include "DSOets.h"
+
+
+DSO_FRAME* workerThread::take()       // latest frame, retained: caller releases
+{
+  DSO_FRAME* f;
+
+  FrameLock.lock();
+  f = Latest;
+  if(f) frame_retain(f);
+  FrameLock.unlock();
+  return f;
+}
+
+
+DSO_FRAME* workerThread::failed()    // mask failure to save, if any: caller ...
+{
+  DSO_FRAME* f;
+
+  FrameLock.lock();
+  f = Failed;
+  Failed = NULL;
+  FrameLock.unlock();
+  return f;                                         // ... releases once written
+}
 
-extern HT6022_DeviceTypeDef Device;                             // Hantek 'scope
 
 void workerThread::run()
 {
   int i, j;
   int Depth;                                     // size of raw interleaved data
   int tp;                         // temporary trigger point, zero if none found
-  unsigned char level;           // offset from Trigger Level for noise immunity
-
-  CH0 = CHA;                                        // initalise buffer pointers
-  CHX = CHB;                                       // traces are double buffered
+  bool fail;                              // acquisition failed the mask test
+  int r;                                               // USB transfer result
+  DSO_TRIGGER Search;                          // each triggered read on its own
+  DSO_SETTINGS* Set;                         // pinned for the buffer being read
+  unsigned int arm = 0;                              // last Arm mode taken from
+  unsigned int config = 0;                      // last Config applied to Device
+  DSO_SETTINGS Applied;                            // SR and IR as set on Device
+  QElapsedTimer timer;
+  DSO_FRAME* Fill = NULL;                        // being read, seen by no other
+  DSO_FRAME* Last;
+  unsigned char* CHX;                                  // Fill's transfer buffer
+  DSO_SETTINGS Pinned;
+  unsigned int rolled = 0;                      // Config of the samples in Roll
+  int decimate;                                    // samples per column to roll
+  int n;                                          // samples of transfer to roll
+  unsigned int streamed = 0;                 // Arm the Stream search started at
+  int channel = 0;                                     // and its trigger source
+  uint64_t stop = 0;           // samples to roll before holding, zero until ...
+  QElapsedTimer paced;                         // ... an edge; and between reads
+  double gap;                                // samples lost since the last read
+  TRIGGER_TIME Timing;                          // of each edge added to Ets ...
+  unsigned int binned = 0;                         // ... under this Config only
+  unsigned int fed = 0;                 // Config streamed to Decoder, else zero
 
   while(alive)
   {
-    Depth = Dso.MemDepth * 2;    // raw data is byte pairs of alternate channels
+    if(!settings_pin(&Pinned))                          // nothing published yet
+    {
+      msleep(100);
+      continue;
+    }
+    if(Pinned.Roll && Unit)       // merged view is not drawn while rolling, ...
+    {
+      msleep(100);                       // ... so no long, slow triggered reads
+      continue;
+    }
+    Depth = (Pinned.Roll ? ROLL_READ : Pinned.Dso.MemDepth) * 2;   // byte pairs
+    DeviceLock.lock();                     // device memory is mapped per handle
+    Fill = frame_get(&Frames, Fill, Depth, Device->DeviceHandle);
+    if(!Fill)                                // all held elsewhere, or no memory
+    {
+      DeviceLock.unlock();
+      msleep(10);
+      continue;
+    }
+    CHX = Fill->Data;
+    Set = &Fill->Settings;                    // one consistent set per transfer
+    *Set = Pinned;
+    if(Set->Arm != arm) arm = Set->Arm, mode = Set->Mode;   // run, stop, re-arm
+                                      // configure between transfers, not during
+    if(Device->DeviceHandle && (!Configured || Set->Config != config))
+    {
+      timer.start();
+      if(!Configured || Set->SR != Applied.SR) HT6022_SetSR(Device, Set->SR);
+      if(!Configured || Set->IR[0] != Applied.IR[0])
+        HT6022_SetCH1IR(Device, Set->IR[0]);
+      if(!Configured || Set->IR[1] != Applied.IR[1])
+        HT6022_SetCH2IR(Device, Set->IR[1]);
+      HT6022_ReadData(Device, CHX, HT6022_1KB, 0);  // discard: settling, or ...
+      Applied = *Set;                      // ... samples from before the change
+      config = Set->Config;
+      Configured = true;
+      SwitchTime = (int)(timer.nsecsElapsed() / 1000);
+    }
+    DeviceLock.unlock();
+
+    if(Set->Roll)                            // strip chart: no trigger, no gaps
+    {
+      if(mode == HOLD)
+      {
+        msleep(10);
+        continue;
+      }
+      DeviceLock.lock();
+      r = Device->DeviceHandle == NULL ? HT6022_ERROR_NO_DEVICE :
+        HT6022_ReadData(Device, CHX, (HT6022_DataSizeTypeDef)ROLL_READ, 0);
+      DeviceLock.unlock();
+      __atomic_store_n(&Connected, r == HT6022_SUCCESS, __ATOMIC_RELEASE);
+      if(r != HT6022_SUCCESS)
+      {
+        if(r == HT6022_ERROR_NO_DEVICE && Device->DeviceHandle)
+          emit deviceLost(Unit);
+        msleep(100);
+        continue;
+      }
+      gap = paced.isValid() ?                     // read to read, less the data
+        paced.nsecsElapsed() * 1e-9 / Set->Dso.Ts - ROLL_READ : 0;
+      paced.start();
+      decimate = roll_decimate(Set->Dso.Tdiv, Set->Dso.Ts);
+      n = ROLL_READ - ROLL_SKIP;
+      if
+      (
+        Set->Arm != streamed || Set->TriggerChannel != channel ||
+        Set->TriggerEdge != Stream.Edge || Set->TriggerLevel != Stream.Level
+      )
+      {
+        trigger_reset
+        (
+          &Stream, Set->TriggerEdge, Set->TriggerLevel, TRIGGER_HYSTERESIS
+        );
+        streamed = Set->Arm, channel = Set->TriggerChannel, stop = 0;
+      }
+      else if(Stream.Samples)          // follows the last, after the 6022's gap
+        trigger_gap(&Stream, ROLL_SKIP + (gap > 0 ? (uint64_t)(gap + 0.5) : 0));
+      trigger_feed(&Stream, CHX + 2 * ROLL_SKIP + channel, 2, n);
+      if(mode == SINGLE && !stop && (i = trigger_next(&Stream)) >= 0)
+        stop = i + (uint64_t)decimate * ROLL_COLUMNS / 2;          // mid screen
+      if(stop && stop <= (uint64_t)n)              // single shot: hold it there
+      {
+        n = (int)stop;
+        mode = HOLD;
+        Triggered = Set->Arm;
+      }
+      else if(stop) stop -= n;                 // chart samples, not stream ones
+      RollLock.lock();
+      if(Roll.Decimate != decimate || Set->Config != rolled)     // start afresh
+        roll_reset(&Roll, decimate), rolled = Set->Config;
+      roll_push(&Roll, CHX + 2 * ROLL_SKIP, n);
+      RollLock.unlock();
+      LogLock.lock();                                     // nothing unless open
+      log_push(&Log, CHX + 2 * ROLL_SKIP, n, Set->IR);
+      LogLock.unlock();
+      if(Decoder && Decode.Protocol != DECODE_OFF)   // follows on from the last
+      {
+        Decoder->submit(CHX + 2 * ROLL_SKIP, 0, n, Set->Config != fed);
+        fed = Set->Config;
+      }
+      else fed = 0;
+      emit dataReady();                            // each transfer, as it comes
+      continue;
+    }
+    fed = 0;                                // a roll run decodes from its start
 
-    if(Dso.MemDepth == HT6022_1KB) j = 32;  // aggressive search for trigger ...
+    if(Set->Dso.MemDepth == HT6022_1KB) j = 32;     // aggressive search for ...
     else j = 1;                            // ... not necesary with long buffers
     tp = 0;                                  // default if no trigger edge found
 
     for(;j;j--)
     {
-      if
-      (
+      DeviceLock.lock();                     // Device may be replaced or ...
+      r = Device->DeviceHandle == NULL ? HT6022_ERROR_NO_DEVICE :
         HT6022_ReadData
         (
-          &Device,
+          Device,
           CHX,
-          (HT6022_DataSizeTypeDef)Dso.MemDepth,
+          (HT6022_DataSizeTypeDef)Set->Dso.MemDepth,
           0
-        ) == HT6022_SUCCESS
-      )
+        );
+      DeviceLock.unlock();                       // ... closed between reads
+      if(r == HT6022_SUCCESS)
       {
-        i = 16 + TriggerChannel;       // less than 10 leads to trigger problems
-        if(TriggerEdge)                                           // rising edge
-        {
-          level = TriggerLevel > 4 ? TriggerLevel - 4 : 0;
-          for(; i < Depth; i+=2) if(CHX[i] < level) break;
-          for(; i < Depth; i+=2) if(CHX[i] >= TriggerLevel) break;
-        }
-        else                                                     // falling edge
-        {
-          level = TriggerLevel < 255-4 ? TriggerLevel + 4 : 255;
-          for(; i < Depth; i+=2) if(CHX[i] > level) break;
-          for(; i < Depth; i+=2) if(CHX[i] <= TriggerLevel) break;
-        }
-
-        if(i < Depth)                                      // trigger edge found
+        trigger_reset                       // a fresh capture, not the stream's
+        (
+          &Search, Set->TriggerEdge, Set->TriggerLevel, TRIGGER_HYSTERESIS
+        );
+        trigger_feed                   // less than 10 leads to trigger problems
+        (
+          &Search, CHX + 16 + Set->TriggerChannel, 2, Set->Dso.MemDepth - 8
+        );
+        if((i = trigger_next(&Search)) >= 0)               // trigger edge found
         {
-          tp = i/2 - 1;                 // sample index just before trigger edge
+          tp = i + 8 - 1;               // sample index just before trigger edge
           break;
         }
       }
+      else break;
+    }
+
+    __atomic_store_n(&Connected, r == HT6022_SUCCESS, __ATOMIC_RELEASE);
+    if(r != HT6022_SUCCESS)                  // unplugged or not yet connected
+    {
+      if(r == HT6022_ERROR_NO_DEVICE && Device->DeviceHandle)
+        emit deviceLost(Unit);
+      msleep(100);
+      continue;
     }
+                              // every triggered acquisition, displayed or not
+    fail = tp && mode != HOLD && Unit == 0 && Mask.Enabled &&
+      mask_test(&Mask, CHX, &Set->Dso, tp);
+
+    if
+    (                                   // every one accepted, shown or not, ...
+      tp && mode != HOLD && Unit == 0 && Set->Ets &&
+      trigger_time
+      (
+        &Timing, CHX + Set->TriggerChannel, 2, Set->Dso.MemDepth, tp + 1,
+        Set->TriggerEdge, Set->TriggerLevel, TRIGGER_SINC
+      )
+    )
+    {
+      EtsLock.lock();                // ... placed by where it crossed the level
+      if
+      (
+        ets_grid
+        (
+          &Ets, Set->Dso.TriggerDelay * Set->Dso.Ts + Set->Dso.TriggerOffset,
+          Set->Dso.Tdiv, Set->Dso.Ts
+        ) || Set->Config != binned
+      ) ets_clear(&Ets), binned = Set->Config;
+      ets_add(&Ets, CHX, Set->Dso.MemDepth, Timing.Crossing, Set->Dso.Ts);
+      EtsLock.unlock();
+    }
+
     if((tp && mode != HOLD) || mode == AUTO)            // free run in AUTO mode
     {
-      if(CHX == CHA) CHX = CHB, CH0 = CHA;                       // swap buffers
-      else CHX = CHA, CH0 = CHB;    // allows concurrent acquisition and display
-      TriggerPoint = tp;       // keep trigger point with corresponding data set
+      Fill->TriggerPoint = tp;           // keep trigger point with its data set
+      Fill->Sequence = ++Frame;
+      FrameLock.lock();                     // hand over Fill with our reference
+      if(fail && Mask.SaveOnFail && !Failed) // written by the GUI, off this ...
+      {
+        frame_retain(Fill);                         // ... thread, one at a time
+        Failed = Fill;
+      }
+      Last = Latest;
+      Latest = Fill;
+      FrameLock.unlock();
+      frame_release(Last);                     // free once the GUI has moved on
+      Fill = NULL;                  // allows concurrent acquisition and display
       if(mode == SINGLE) mode = HOLD;
+      if(fail && Mask.StopOnFail) mode = HOLD;     // keep the failure on screen
     }
     emit dataReady();                                   // signal display update
-    msleep(holdoff);            // holdoff for display update on single core CPU
+    msleep(Set->Holdoff);       // holdoff for display update on single core CPU
   }
 }
 
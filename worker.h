@@ -24,27 +24,49 @@
 #ifndef WORKER_H
 #define WORKER_H
 #include <QThread>
+#include <QMutex>
 #include "HT6022.h"
 #include "dso.h"
+#include "DSOsettings.h"
+#include "DSOframe.h"
+#include "DSOroll.h"
+#include "DSOlog.h"
+#include "DSOtrigger.h"
+#include "DSOets.h"
+#include "decoder.h"
 
 class workerThread : public QThread
 {
     Q_OBJECT
 public:
-    unsigned char* CH0;
-    int TriggerPoint;                       // in terms of sample index position
-    int TriggerEdge;                        // 0 (falling edge), 1 (rising edge)
-    int TriggerChannel;                          // 0 (Channel 1), 1 (Channel 2)
-    int holdoff;               // delay in ms between sucessive data acquisition
+    HT6022_DeviceTypeDef* Device;                  // 'scope this thread reads
+    QMutex DeviceLock;              // held for each transfer and to swap Device
+    bool Configured;           // cleared with DeviceLock held as Device changes
+    int Connected;             // last transfer succeeded: set here, read atomic
+    int SwitchTime;                // us taken to apply the last SR or IR change
+    int Unit;                               // 0 is the fully featured 'scope
+    DSO_FRAME_POOL Frames;           // transfer buffers, see frame_pool_stats()
+    DSO_FRAME* Latest;                    // last accepted frame, guarded by ...
+    DSO_FRAME* Failed;               // ... as is one failing the mask test, ...
+    QMutex FrameLock;                          // ... this, so take() it instead
     int alive;                                         // for thread termination
-    DSO_MODE_TypeDef mode;                         // AUTO, NORMAL, SINGLE, HOLD
-    unsigned char TriggerLevel;                                       // 0 - 255
+    unsigned int Frame;              // incremented each time Latest is replaced
+    DSO_MODE_TypeDef mode;         // AUTO, NORMAL, SINGLE, HOLD: set when armed
+    DSO_ROLL Roll;                      // strip chart in roll mode, guarded ...
+    QMutex RollLock;                                  // ... by this while read
+    DSO_LOG Log;                     // statistics while rolling, opened and ...
+    QMutex LogLock;                          // ... closed by the GUI under this
+    DSO_TRIGGER Stream;         // single shot edge search across roll transfers
+    unsigned int Triggered;         // Arm under which it last held, for the GUI
+    DSO_ETS Ets;              // equivalent time picture, cleared by the GUI ...
+    QMutex EtsLock;                                  // ... or worker under this
+    decoderThread* Decoder;               // fed each roll transfer, if not NULL
+    DSO_FRAME* take();
+    DSO_FRAME* failed();
 signals:
     void dataReady();
+    void deviceLost(int unit);           // transfer failed: device unplugged
 private:
-    unsigned char CHA[1024*1024*2];              // double buffer wavefom traces
-    unsigned char CHB[1024*1024*2];
-    unsigned char* CHX;           // last buffer filled and available to be read
     void run();
 };
 